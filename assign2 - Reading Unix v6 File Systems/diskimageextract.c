@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "pathname.h"
+#include "extract.h"
+
+static void PrintUsageAndExit(char *progname);
+
+int main(int argc, char *argv[]) {
+  const char *pathname = "/";
+  int opt;
+  while ((opt = getopt(argc, argv, "p:")) != -1) {
+    switch (opt) {
+    case 'p':
+      pathname = optarg;
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+
+  if (optind != argc-2) {
+    PrintUsageAndExit(argv[0]);
+  }
+
+  char *diskpath = argv[optind];
+  char *hostpath = argv[optind+1];
+  int fd = diskimg_open(diskpath, 1);
+  if (fd < 0) {
+    fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+    exit(EXIT_FAILURE);
+  }
+
+  struct unixfilesystem *fs = unixfilesystem_init(fd);
+  if (!fs) {
+    fprintf(stderr, "Failed to initialize unix filesystem\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int inumber = pathname_lookup(fs, pathname);
+  if (inumber < 0) {
+    fprintf(stderr, "Can't find %s\n", pathname);
+    (void) diskimg_close(fd);
+    free(fs);
+    exit(EXIT_FAILURE);
+  }
+
+  int err = extract_tree(fs, inumber, hostpath);
+  if (diskimg_close(fd) < 0) fprintf(stderr, "Error closing %s\n", diskpath);
+  free(fs);
+  exit(err < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+  return 0;
+}
+
+static void PrintUsageAndExit(char *progname) {
+  fprintf(stderr, "Usage: %s <options> diskimagePath hostPath\n", progname);
+  fprintf(stderr, "where <options> can be:\n");
+  fprintf(stderr, "-p pathname     extract only pathname (default /)\n");
+  exit(EXIT_FAILURE);
+}
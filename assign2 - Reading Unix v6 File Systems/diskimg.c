@@ -18,6 +18,11 @@ int diskimg_readsector(int fd, int sectorNum,  void *buf) {
   return read(fd, buf, DISKIMG_SECTOR_SIZE);
 }
 
+int diskimg_readsectors(int fd, int sectorNum, int numSectors, void *buf) {
+  return pread(fd, buf, (size_t) numSectors * DISKIMG_SECTOR_SIZE,
+               (off_t) sectorNum * DISKIMG_SECTOR_SIZE);
+}
+
 int diskimg_writesector(int fd, int sectorNum,  void *buf) {
   if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) {
     return -1;
@@ -23,6 +23,12 @@ int diskimg_getsize(int fd);
  */
 int diskimg_readsector(int fd, int sectorNum, void *buf); 
 
+/**
+ * Reads numSectors consecutive sectors starting at sectorNum into buf with a
+ * single positioned read.  Returns the number of bytes read, or -1 on error.
+ */
+int diskimg_readsectors(int fd, int sectorNum, int numSectors, void *buf);
+
 /**
  * Writes the specified sector from the disk.  Returns the number of bytes
  * written, or -1 on error.
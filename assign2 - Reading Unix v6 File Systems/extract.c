@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "extract.h"
+#include "inode.h"
+#include "diskimg.h"
+
+#define CHUNK_SECTORS 128   // 64KB of file data per pipeline slot
+#define CHUNK_SIZE (CHUNK_SECTORS*DISKIMG_SECTOR_SIZE)
+#define NUM_SLOTS 16
+#define MAX_FILE_BLOCKS 32768   // 24-bit i_size / DISKIMG_SECTOR_SIZE
+#define DIR_ENTRY_SIZE 14
+#define MAXPATH 1024
+
+/**
+ * One chunk of a host file on its way from the reader to the writer.  The
+ * slot holding the final chunk of a file has last set, which tells the writer
+ * to close fd once the chunk is out.
+ */
+struct slot {
+  int fd;
+  int len;
+  int last;
+  char data[CHUNK_SIZE];
+};
+
+/**
+ * Bounded ring of slots shared by the reader (the thread walking the image)
+ * and the writer thread.  Slots [head, head + count) are full and owned by the
+ * writer; the slot at tail is owned by the reader until it is published.
+ */
+struct pipeline {
+  struct slot *slots;
+  int head;
+  int tail;
+  int count;
+  int done;
+  int err;
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+};
+
+struct extractor {
+  struct unixfilesystem *fs;
+  struct pipeline pipe;
+  uint16_t blocks[MAX_FILE_BLOCKS];
+};
+
+static int write_fully(int fd, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t n = writev(fd, iov, iovcnt);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+
+    while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *) iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Drains the pipeline, gathering every run of consecutive full slots that
+ * belong to the same host file into a single writev.
+ */
+static void *writer_main(void *arg) {
+  struct pipeline *pipe = arg;
+  struct iovec iov[NUM_SLOTS];
+
+  while (1) {
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->count == 0 && !pipe->done)
+      pthread_cond_wait(&pipe->notEmpty, &pipe->lock);
+    if (pipe->count == 0) {
+      pthread_mutex_unlock(&pipe->lock);
+      break;
+    }
+
+    int fd = pipe->slots[pipe->head].fd;
+    int n = 0;
+    int last = 0;
+    while (n < pipe->count && !last) {
+      struct slot *s = &pipe->slots[(pipe->head + n) % NUM_SLOTS];
+      if (s->fd != fd) break;
+      iov[n].iov_base = s->data;
+      iov[n].iov_len = s->len;
+      last = s->last;
+      n++;
+    }
+    pthread_mutex_unlock(&pipe->lock);
+
+    int err = write_fully(fd, iov, n) < 0;
+    if (err) fprintf(stderr, "Error writing extracted file: %s\n", strerror(errno));
+    if (last && close(fd) < 0) err = 1;
+
+    pthread_mutex_lock(&pipe->lock);
+    if (err) pipe->err = -1;
+    pipe->head = (pipe->head + n) % NUM_SLOTS;
+    pipe->count -= n;
+    pthread_cond_signal(&pipe->notFull);
+    pthread_mutex_unlock(&pipe->lock);
+  }
+
+  return NULL;
+}
+
+static struct slot *acquire_slot(struct pipeline *pipe) {
+  pthread_mutex_lock(&pipe->lock);
+  while (pipe->count == NUM_SLOTS)
+    pthread_cond_wait(&pipe->notFull, &pipe->lock);
+  struct slot *s = &pipe->slots[pipe->tail];
+  pthread_mutex_unlock(&pipe->lock);
+  return s;
+}
+
+static void publish_slot(struct pipeline *pipe) {
+  pthread_mutex_lock(&pipe->lock);
+  pipe->tail = (pipe->tail + 1) % NUM_SLOTS;
+  pipe->count++;
+  pthread_cond_signal(&pipe->notEmpty);
+  pthread_mutex_unlock(&pipe->lock);
+}
+
+/**
+ * Reads blocks[first, first + count) into buf, issuing one positioned read per
+ * run of physically consecutive sectors.  Holes read back as zeroes.
+ * Returns 0 on success, -1 on error.
+ */
+static int read_blocks(struct unixfilesystem *fs, const uint16_t *blocks, int first, int count, char *buf) {
+  int i = 0;
+  while (i < count) {
+    int sector = blocks[first + i];
+    int run = 1;
+    if (sector == 0) {
+      while (i + run < count && blocks[first + i + run] == 0) run++;
+      memset(buf + i*DISKIMG_SECTOR_SIZE, 0, run*DISKIMG_SECTOR_SIZE);
+    } else {
+      while (i + run < count && blocks[first + i + run] == sector + run) run++;
+      if (diskimg_readsectors(fs->dfd, sector, run, buf + i*DISKIMG_SECTOR_SIZE) < 0)
+        return -1;
+    }
+    i += run;
+  }
+  return 0;
+}
+
+static int extract_file(struct extractor *ex, struct inode *in, const char *hostpath) {
+  int size = inode_getsize(in);
+  int num_blocks = inode_blockmap(ex->fs, in, ex->blocks, MAX_FILE_BLOCKS);
+  if (num_blocks < 0) {
+    fprintf(stderr, "Can't map blocks of %s\n", hostpath);
+    return -1;
+  }
+
+  int fd = open(hostpath, O_WRONLY | O_CREAT | O_TRUNC, in->i_mode & 0777);
+  if (fd < 0) {
+    fprintf(stderr, "Can't create %s: %s\n", hostpath, strerror(errno));
+    return -1;
+  }
+
+  // Always publish at least one slot, even for an empty file, so the writer
+  // sees a last chunk and closes fd.
+  int err = 0;
+  int bno = 0;
+  do {
+    int count = num_blocks - bno < CHUNK_SECTORS ? num_blocks - bno : CHUNK_SECTORS;
+    struct slot *s = acquire_slot(&ex->pipe);
+    s->fd = fd;
+    s->len = 0;
+    if (read_blocks(ex->fs, ex->blocks, bno, count, s->data) < 0) {
+      fprintf(stderr, "Error reading %s from disk image\n", hostpath);
+      err = -1;
+      count = num_blocks - bno;
+    } else {
+      int remaining = size - bno*DISKIMG_SECTOR_SIZE;
+      s->len = remaining < CHUNK_SIZE ? remaining : CHUNK_SIZE;
+    }
+    bno += count;
+    s->last = (bno >= num_blocks);
+    publish_slot(&ex->pipe);
+  } while (bno < num_blocks);
+
+  return err;
+}
+
+static int extract_inode(struct extractor *ex, int inumber, const char *hostpath);
+
+static int extract_directory(struct extractor *ex, struct inode *in, const char *hostpath) {
+  if (mkdir(hostpath, 0777) < 0 && errno != EEXIST) {
+    fprintf(stderr, "Can't create directory %s: %s\n", hostpath, strerror(errno));
+    return -1;
+  }
+
+  int num_blocks = inode_blockmap(ex->fs, in, ex->blocks, MAX_FILE_BLOCKS);
+  if (num_blocks < 0) {
+    fprintf(stderr, "Can't map blocks of %s\n", hostpath);
+    return -1;
+  }
+
+  // Pull the whole directory in before recursing, since the children reuse
+  // ex->blocks.
+  char *buf = malloc((size_t) num_blocks*DISKIMG_SECTOR_SIZE);
+  if (num_blocks > 0 && buf == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return -1;
+  }
+  if (read_blocks(ex->fs, ex->blocks, 0, num_blocks, buf) < 0) {
+    fprintf(stderr, "Error reading directory %s\n", hostpath);
+    free(buf);
+    return -1;
+  }
+
+  int err = 0;
+  int numentries = inode_getsize(in)/sizeof(struct direntv6);
+  struct direntv6 *entries = (struct direntv6 *) buf;
+  for (int i = 0; i < numentries; i++) {
+    if (entries[i].d_inumber == 0) continue;
+
+    char name[DIR_ENTRY_SIZE + 1];
+    memcpy(name, entries[i].d_name, DIR_ENTRY_SIZE);
+    name[DIR_ENTRY_SIZE] = '\0';
+    if (!strcmp(name, ".") || !strcmp(name, "..")) continue;
+
+    char nextpath[MAXPATH];
+    if (snprintf(nextpath, MAXPATH, "%s/%s", hostpath, name) >= MAXPATH) {
+      fprintf(stderr, "Too deep of directories %s\n", hostpath);
+      err = -1;
+      continue;
+    }
+    if (extract_inode(ex, entries[i].d_inumber, nextpath) < 0) err = -1;
+  }
+
+  free(buf);
+  return err;
+}
+
+static int extract_inode(struct extractor *ex, int inumber, const char *hostpath) {
+  struct inode in;
+  if (inode_iget(ex->fs, inumber, &in) < 0) {
+    fprintf(stderr, "Can't read inode %d\n", inumber);
+    return -1;
+  }
+  if (!(in.i_mode & IALLOC)) {
+    fprintf(stderr, "Inode %d for %s isn't allocated\n", inumber, hostpath);
+    return -1;
+  }
+
+  switch (in.i_mode & IFMT) {
+  case IFDIR:
+    return extract_directory(ex, &in, hostpath);
+  case 0:
+    return extract_file(ex, &in, hostpath);
+  default:
+    fprintf(stderr, "Skipping special file %s\n", hostpath);
+    return 0;
+  }
+}
+
+int extract_tree(struct unixfilesystem *fs, int inumber, const char *hostpath) {
+  struct extractor *ex = malloc(sizeof(struct extractor));
+  struct slot *slots = malloc(NUM_SLOTS * sizeof(struct slot));
+  if (ex == NULL || slots == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    free(ex);
+    free(slots);
+    return -1;
+  }
+
+  ex->fs = fs;
+  ex->pipe.slots = slots;
+  ex->pipe.head = ex->pipe.tail = ex->pipe.count = 0;
+  ex->pipe.done = 0;
+  ex->pipe.err = 0;
+  pthread_mutex_init(&ex->pipe.lock, NULL);
+  pthread_cond_init(&ex->pipe.notEmpty, NULL);
+  pthread_cond_init(&ex->pipe.notFull, NULL);
+
+  pthread_t writer;
+  if (pthread_create(&writer, NULL, writer_main, &ex->pipe) != 0) {
+    fprintf(stderr, "Can't start writer thread\n");
+    free(ex);
+    free(slots);
+    return -1;
+  }
+
+  int err = extract_inode(ex, inumber, hostpath);
+
+  pthread_mutex_lock(&ex->pipe.lock);
+  ex->pipe.done = 1;
+  pthread_cond_signal(&ex->pipe.notEmpty);
+  pthread_mutex_unlock(&ex->pipe.lock);
+  pthread_join(writer, NULL);
+  if (ex->pipe.err < 0) err = -1;
+
+  pthread_mutex_destroy(&ex->pipe.lock);
+  pthread_cond_destroy(&ex->pipe.notEmpty);
+  pthread_cond_destroy(&ex->pipe.notFull);
+  free(slots);
+  free(ex);
+  return err;
+}
@@ -0,0 +1,15 @@
+#ifndef _EXTRACT_H_
+#define _EXTRACT_H_
+
+#include "unixfilesystem.h"
+
+/**
+ * Recreates the file or directory tree rooted at inumber under hostpath on the
+ * host file system.  File contents are pulled off the disk image by a reader
+ * while a separate writer thread pushes them out to the host, so image reads
+ * overlap with host writes.  Returns 0 on success, -1 if anything failed to
+ * extract.
+ */
+int extract_tree(struct unixfilesystem *fs, int inumber, const char *hostpath);
+
+#endif // _EXTRACT_H_
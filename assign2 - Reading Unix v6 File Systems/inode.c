@@ -8,6 +8,7 @@
 #define INDIR_ADDR 7
 #define INODES_PER_BLOCK 16
 #define NUM_BLOCKS_PER_BLOCK 256
+#define NUM_ADDR_ENTRIES 8
 
 
 /**
@@ -79,6 +80,72 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
   return 0;
 }
 
+/**
+ * Copies up to count block numbers out of the indirect block at sector into
+ * blocks.  An unallocated (zero) indirect block yields holes.
+ */
+static int copy_indirect(struct unixfilesystem *fs, int sector, uint16_t *blocks, int count) {
+  uint16_t indirect_blocks[NUM_BLOCKS_PER_BLOCK];
+  if (count > NUM_BLOCKS_PER_BLOCK) count = NUM_BLOCKS_PER_BLOCK;
+
+  if (sector == 0)
+  {
+    memset(blocks, 0, count * sizeof(uint16_t));
+    return count;
+  }
+
+  if (diskimg_readsector(fs->dfd, sector, indirect_blocks) < 0)
+    return -1;
+  memcpy(blocks, indirect_blocks, count * sizeof(uint16_t));
+  return count;
+}
+
+/**
+ * Resolves every block of the file described by the given inode into blocks,
+ * in file order, reading each indirect block only once.  A block number of 0
+ * marks a hole.
+ *
+ * Returns the number of blocks resolved, -1 on error or if the file has more
+ * than maxBlocks blocks.
+ */
+int inode_blockmap(struct unixfilesystem *fs, struct inode *inp, uint16_t *blocks, int maxBlocks) {
+  int size = inode_getsize(inp);
+  int num_blocks = (size + DISKIMG_SECTOR_SIZE - 1)/DISKIMG_SECTOR_SIZE;
+  if (num_blocks > maxBlocks) return -1;
+
+  if ( !(inp->i_mode & ILARG) )
+  {
+    if (num_blocks > NUM_ADDR_ENTRIES) return -1;
+    memcpy(blocks, inp->i_addr, num_blocks * sizeof(uint16_t));
+    return num_blocks;
+  }
+
+  // i_addr[0..6] are singly indirect, i_addr[7] is doubly indirect
+  int count = 0;
+  for (int i = 0; i < INDIR_ADDR && count < num_blocks; i++)
+  {
+    int n = copy_indirect(fs, inp->i_addr[i], blocks + count, num_blocks - count);
+    if (n < 0) return -1;
+    count += n;
+  }
+
+  if (count < num_blocks)
+  {
+    uint16_t double_indirect_blocks[NUM_BLOCKS_PER_BLOCK];
+    if (copy_indirect(fs, inp->i_addr[INDIR_ADDR], double_indirect_blocks, NUM_BLOCKS_PER_BLOCK) < 0)
+      return -1;
+
+    for (int i = 0; i < NUM_BLOCKS_PER_BLOCK && count < num_blocks; i++)
+    {
+      int n = copy_indirect(fs, double_indirect_blocks[i], blocks + count, num_blocks - count);
+      if (n < 0) return -1;
+      count += n;
+    }
+  }
+
+  return count;
+}
+
 /**
  * Computes the size in bytes of the file identified by the given inode
  */
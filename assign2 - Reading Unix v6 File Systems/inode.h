@@ -17,6 +17,16 @@ int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp);
  */
 int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum);
 
+/**
+ * Resolves every block of the file described by the given inode into blocks,
+ * in file order, reading each indirect block only once.  A block number of 0
+ * marks a hole.
+ *
+ * Returns the number of blocks resolved, -1 on error or if the file has more
+ * than maxBlocks blocks.
+ */
+int inode_blockmap(struct unixfilesystem *fs, struct inode *inp, uint16_t *blocks, int maxBlocks);
+
 /**
  * Computes the size in bytes of the file identified by the given inode
  */
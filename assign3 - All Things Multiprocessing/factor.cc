@@ -0,0 +1,260 @@
+/**
+ * File: factor.cc
+ * ---------------
+ * Presents a native drop-in replacement for factor.py.  It reads one number per
+ * line from standard input and publishes its prime factorization in exactly the
+ * format factor.py uses:
+ *
+ *    60 = 2 * 2 * 3 * 5 [pid: 1234, time: 2.1e-06 seconds]
+ *
+ * When passed --self-halting, it stops itself with SIGSTOP before reading each
+ * number, just like factor.py.
+ *
+ * Small factors are stripped with trial division over a mod-30 wheel.  Whatever
+ * remains is split with Pollard's rho (Brent's variant) and certified with a
+ * deterministic Miller-Rabin test, both running on Montgomery arithmetic so no
+ * 128-bit division ever happens in the inner loops.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+using namespace std;
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+static const string kSelfHaltingFlag = "--self-halting";
+static const uint64_t kTrialDivisionLimit = 1 << 10;
+
+/**
+ * Type: Montgomery
+ * ----------------
+ * Arithmetic modulo an odd n in Montgomery form, with R = 2^64.
+ */
+struct Montgomery {
+  uint64_t n;
+  uint64_t inv;  // n^-1 mod 2^64
+  uint64_t r2;   // R^2 mod n
+
+  Montgomery(uint64_t n) : n(n) {
+    inv = n;
+    for (int i = 0; i < 5; i++) inv *= 2 - n * inv;
+    uint64_t r = (0 - n) % n;
+    r2 = (uint128_t) r * r % n;
+  }
+
+  uint64_t reduce(uint128_t t) const {
+    uint64_t m = (uint64_t) t * inv;
+    uint64_t hi = t >> 64;
+    uint64_t mn = ((uint128_t) m * n) >> 64;
+    return hi >= mn ? hi - mn : hi - mn + n;
+  }
+
+  uint64_t to(uint64_t a) const { return reduce((uint128_t) a * r2); }
+  uint64_t from(uint64_t a) const { return reduce(a); }
+  uint64_t mul(uint64_t a, uint64_t b) const { return reduce((uint128_t) a * b); }
+  uint64_t add(uint64_t a, uint64_t b) const {
+    uint64_t s = a + b;
+    return (s >= n || s < a) ? s - n : s;
+  }
+
+  uint64_t pow(uint64_t a, uint64_t e) const {
+    uint64_t result = to(1);
+    while (e > 0) {
+      if (e & 1) result = mul(result, a);
+      a = mul(a, a);
+      e >>= 1;
+    }
+    return result;
+  }
+};
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/**
+ * Function: isPrime
+ * -----------------
+ * Deterministic Miller-Rabin for odd n > kTrialDivisionLimit; the first twelve
+ * prime bases suffice for every 64-bit n.
+ */
+static bool isPrime(uint64_t n) {
+  static const uint64_t kBases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  Montgomery mont(n);
+  uint64_t d = n - 1;
+  int s = 0;
+  while ((d & 1) == 0) {
+    d >>= 1;
+    s++;
+  }
+
+  uint64_t one = mont.to(1), minusOne = mont.to(n - 1);
+  for (uint64_t base: kBases) {
+    uint64_t x = mont.pow(mont.to(base % n), d);
+    if (x == one || x == minusOne) continue;
+    bool composite = true;
+    for (int r = 1; r < s && composite; r++) {
+      x = mont.mul(x, x);
+      if (x == minusOne) composite = false;
+    }
+    if (composite) return false;
+  }
+  return true;
+}
+
+/**
+ * Function: findDivisor
+ * ---------------------
+ * Pollard's rho with Brent's cycle detection, accumulating 128 differences
+ * into a single product per gcd.  n must be odd and composite.
+ */
+static uint64_t findDivisor(uint64_t n) {
+  static const uint64_t kBatch = 128;
+  Montgomery mont(n);
+  for (uint64_t c = 1; ; c++) {
+    uint64_t mc = mont.to(c);
+    uint64_t y = mont.to(2), x = y, ys = y, q = mont.to(1), g = 1;
+    for (uint64_t r = 1; g == 1; r <<= 1) {
+      x = y;
+      for (uint64_t i = 0; i < r; i++) y = mont.add(mont.mul(y, y), mc);
+      for (uint64_t k = 0; k < r && g == 1; k += kBatch) {
+        ys = y;
+        for (uint64_t i = 0; i < kBatch && i < r - k; i++) {
+          y = mont.add(mont.mul(y, y), mc);
+          q = mont.mul(q, x > y ? x - y : y - x);
+        }
+        g = gcd(mont.from(q), n);
+      }
+    }
+
+    if (g == n) {
+      // The batch overshot; retrace it one step at a time.
+      do {
+        ys = mont.add(mont.mul(ys, ys), mc);
+        g = gcd(x > ys ? x - ys : ys - x, n);
+      } while (g == 1);
+    }
+    if (g != n) return g;
+  }
+}
+
+static void factorLargeOdd(uint64_t n, vector<uint64_t>& factors) {
+  if (isPrime(n)) {
+    factors.push_back(n);
+    return;
+  }
+  uint64_t d = findDivisor(n);
+  factorLargeOdd(d, factors);
+  factorLargeOdd(n / d, factors);
+}
+
+/**
+ * Function: factor
+ * ----------------
+ * Populates factors with the prime factorization of n > 1.
+ */
+static void factor(uint64_t n, vector<uint64_t>& factors) {
+  static const uint64_t kWheel[] = {4, 2, 4, 2, 4, 6, 2, 6}; // gaps between 7, 11, 13, ..., 37
+  for (uint64_t p: {2, 3, 5}) {
+    while (n % p == 0) {
+      factors.push_back(p);
+      n /= p;
+    }
+  }
+
+  uint64_t p = 7;
+  for (size_t i = 0; p <= kTrialDivisionLimit && p * p <= n; p += kWheel[i++ % 8]) {
+    while (n % p == 0) {
+      factors.push_back(p);
+      n /= p;
+    }
+  }
+
+  if (n == 1) return;
+  if (p * p > n) {
+    factors.push_back(n);
+    return;
+  }
+  factorLargeOdd(n, factors);
+  sort(factors.begin(), factors.end());
+}
+
+/**
+ * Function: factorization
+ * -----------------------
+ * Renders num's factorization the way factor.py does, including its
+ * treatment of 1 and of numbers below 2.
+ */
+static string factorization(long long num) {
+  string response = to_string(num) + " = ";
+  if (num < 1) return response;
+  vector<uint64_t> factors;
+  if (num > 1) factor(num, factors);
+  if (factors.size() <= 1) return response + to_string(num);
+
+  for (size_t i = 0; i < factors.size(); i++) {
+    if (i > 0) response += " * ";
+    response += to_string(factors[i]);
+  }
+  return response;
+}
+
+static bool parseNumber(const char *line, long long& num) {
+  char *end;
+  errno = 0;
+  num = strtoll(line, &end, 10);
+  if (errno != 0 || end == line) return false;
+  while (isspace(static_cast<unsigned char>(*end))) end++;
+  return *end == '\0';
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  // Same as factor.py: don't outlive the parent (most likely ./farm).
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  bool selfHalting = argc > 1 && argv[1] == kSelfHaltingFlag;
+  pid_t pid = getpid();
+  char *line = NULL;
+  size_t capacity = 0;
+  while (true) {
+    if (selfHalting) raise(SIGSTOP);
+    if (getline(&line, &capacity, stdin) < 0) break;
+    long long num;
+    if (!parseNumber(line, num)) {
+      fprintf(stderr, "invalid number: %s", line);
+      free(line);
+      return 1;
+    }
+
+    double start = now();
+    string response = factorization(num);
+    double stop = now();
+    printf("%s [pid: %d, time: %g seconds]\n", response.c_str(), pid, stop - start);
+    fflush(stdout);
+  }
+
+  free(line);
+  return 0;
+}
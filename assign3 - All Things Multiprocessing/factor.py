@@ -35,5 +35,5 @@ while True:
     start = time.time()
     response = factorization(num)
     stop = time.time()
-    print ('%s [pid: %d, time: %g seconds]' % (response, pid, stop - start))
+    print ('%s [pid: %d, time: %g seconds]' % (response, pid, stop - start), flush=True)
 
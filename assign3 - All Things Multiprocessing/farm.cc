@@ -1,136 +1,228 @@
 #include <cassert>
 #include <ctime>
+#include <string>
 #include <cctype>
 #include <cstdio>
 #include <iostream>
 #include <cstdlib>
-#include <vector>
+#include <deque>
+#include <fstream>
 #include <map>
-#include <sys/wait.h>
+#include <vector>
+#include <cmath>
 #include <unistd.h>
+#include <signal.h>
 #include <sched.h>
-#include "subprocess.h"
-
-#include <ext/stdio_filebuf.h>
-#include <fstream>
+#include "process-pool.h"
 
 using namespace std;
-using namespace __gnu_cxx; // __gnu_cxx::stdio_filebuf -> stdio_filebuf
 
-struct worker {
-	worker() {}
-	worker(char *argv[]) : sp(subprocess(argv, true, false)), available(false) {}
-	subprocess_t sp;
-	bool available;
+static const string kExecutable = "./factor";
+static const string kCPUTopologyDir = "/sys/devices/system/cpu/cpu";
+static const string kLoadAverageFile = "/proc/loadavg";
+static const string kCgroupV2QuotaFile = "/sys/fs/cgroup/cpu.max";
+static const string kCgroupV1QuotaFile = "/sys/fs/cgroup/cpu/cpu.cfs_quota_us";
+static const string kCgroupV1PeriodFile = "/sys/fs/cgroup/cpu/cpu.cfs_period_us";
+
+/**
+ * Answers are published in input order.  The pool numbers tasks from 0 in
+ * the order they're scheduled, so reorderBuffer[k] holds the answer for
+ * input number nextToEmit + k once it arrives.  Numbers are only scheduled
+ * while they fall within kReorderCapacity of nextToEmit, so one slow number
+ * can't make the buffer grow without bound.
+ */
+struct answer {
+  bool done;
+  string text;
 };
 
+static const size_t kReorderCapacity = 4096;
+static deque<answer> reorderBuffer;
+static size_t nextToEmit = 0;
+
+static void recordAnswer(size_t sequence, const string& result) {
+  answer& a = reorderBuffer[sequence - nextToEmit];
+  a.done = true;
+  if (!result.empty()) a.text = result + "\n";
+  while (!reorderBuffer.empty() && reorderBuffer.front().done) {
+    const string& front = reorderBuffer.front().text;
+    fwrite(front.data(), 1, front.size(), stdout);
+    reorderBuffer.pop_front();
+    nextToEmit++;
+  }
+  if (reorderBuffer.empty()) fflush(stdout);
+}
 
-static const size_t kNumCPUs = sysconf(_SC_NPROCESSORS_ONLN);
-static vector<worker> workers(kNumCPUs);
-static size_t numWorkersAvailable = 0;
-
-static map<pid_t, int> pid_workers_ix;
-static const string kExecutable = "./factor.py";
-static const string kArg = "--self-halting";
+/**
+ * Workers are placed according to the machine's topology and how busy it is.
+ * placement lists the CPUs we may run on, one per physical core first (round
+ * robin across packages), then the SMT siblings of those cores.  When the
+ * host has a CPU to spare for every worker, worker i is pinned to
+ * placement[i].  When load or the cgroup quota leaves fewer workers than
+ * CPUs, placement is cut down to its first numWorkers entries, so the workers
+ * get distinct physical cores before any SMT siblings.  Pinning on such a
+ * contended host would tie a worker to a CPU someone else may be saturating,
+ * so workers are left free to run anywhere in that smaller set instead.
+ */
+static vector<int> placement;
+static bool pinWorkers = true;
+
+static bool readValue(const string& path, long long& value) {
+  ifstream in(path.c_str());
+  in >> value;
+  return !in.fail();
+}
 
-static void markWorkersAsAvailable(int sig) {
-  while (true)
-  { 
-    int status;
-    pid_t pid = waitpid(-1, &status, WUNTRACED | WNOHANG);
-    if (pid <= 0 || WIFCONTINUED(status) ) break;
-    workers[pid_workers_ix[pid]].available = true;
-    numWorkersAvailable++;
+/**
+ * Function: computePlacement
+ * --------------------------
+ * Orders the CPUs in our affinity mask so that consecutive workers land on
+ * distinct physical cores for as long as possible.  CPUs whose topology
+ * can't be read are treated as cores of their own.
+ */
+static vector<int> computePlacement() {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+    CPU_ZERO(&allowed);
+    for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, &allowed);
   }
-}
 
-static void spawnAllWorkers() {
-  char *argv[] = {const_cast<char *>(kExecutable.c_str()), const_cast<char *>(kArg.c_str())};
-  for (size_t i = 0; i < kNumCPUs; i++)
-  {
-    cpu_set_t cpu_set;
-    CPU_ZERO(&cpu_set);
-    worker w = worker(argv);
-    workers[i] = w;
-    pid_workers_ix.insert({w.sp.pid, i});
-    CPU_SET(i,&cpu_set);
-
-    if (sched_setaffinity(w.sp.pid, sizeof(cpu_set), &cpu_set) < 0)
-      perror("sched_setaffinity");
-
-    printf("Worker %d is set to run on CPU %ld\n", workers[i].sp.pid, pid_workers_ix[w.sp.pid]);
+  // package -> core -> logical CPUs on that core
+  map<long long, map<long long, vector<int>>> packages;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) continue;
+    string topology = kCPUTopologyDir + to_string(cpu) + "/topology/";
+    long long package, core;
+    if (!readValue(topology + "physical_package_id", package) ||
+        !readValue(topology + "core_id", core)) {
+      package = -1;
+      core = cpu;
+    }
+    packages[package][core].push_back(cpu);
   }
-}
 
-static size_t getAvailableWorker() {
-  sigset_t mask;
-  sigemptyset(&mask);
-  while(!numWorkersAvailable)
-    sigsuspend(&mask);
-  
-  for (size_t i = 0; i < kNumCPUs; i++)
-  {
-    if (workers[i].available)
-    {
-      numWorkersAvailable--;
-      workers[i].available = false;
-      return i;
+  vector<vector<int>> cores;
+  vector<map<long long, vector<int>>::const_iterator> next;
+  for (const auto& package: packages) next.push_back(package.second.begin());
+  for (bool more = true; more; ) {
+    more = false;
+    size_t p = 0;
+    for (const auto& package: packages) {
+      if (next[p] != package.second.end()) {
+        cores.push_back((next[p]++)->second);
+        more = true;
+      }
+      p++;
     }
   }
 
-  return -1;
+  vector<int> order;
+  for (size_t sibling = 0; order.size() < (size_t) CPU_COUNT(&allowed); sibling++)
+    for (const vector<int>& core: cores)
+      if (sibling < core.size()) order.push_back(core[sibling]);
+  return order;
 }
 
-static void publishWordsToChild(int to, string number) {
-	stdio_filebuf<char> outbuf(to, std::ios::out);
-	ostream os(&outbuf);
-	os << number + "\n" << endl;
+/**
+ * Function: computeCPUQuota
+ * -------------------------
+ * Returns how many CPUs' worth of time our cgroup may use (rounded up), or
+ * 0 if there's no quota.  Handles both cgroup v2 and v1.
+ */
+static size_t computeCPUQuota() {
+  ifstream v2(kCgroupV2QuotaFile.c_str());
+  string quota;
+  long long period = 0, limit = 0;
+  if (v2 >> quota >> period) {
+    if (quota == "max" || period <= 0) return 0;
+    limit = stoll(quota);
+  } else if (!readValue(kCgroupV1QuotaFile, limit) || !readValue(kCgroupV1PeriodFile, period) ||
+             limit <= 0 || period <= 0) {
+    return 0;
+  }
+  return (limit + period - 1) / period;
 }
 
-static void broadcastNumbersToWorkers() {
-	while (true) {
-		string line;
-		getline(cin, line);
-		if (cin.fail()) break;
-		size_t endpos;
-		long long num = stoll(line, &endpos);
-		if (endpos != line.size()) break;
-    size_t i = getAvailableWorker();
-    kill (workers[i].sp.pid, SIGCONT);
-    dprintf(workers[i].sp.supplyfd, "%lld\n", num);
-	}
-}
+/**
+ * Function: computeNumWorkers
+ * ---------------------------
+ * Starts from one worker per CPU we may run on and scales down to fit the
+ * cgroup's CPU quota and whatever the rest of the machine is already using,
+ * as measured by the one-minute load average.  Always at least one.
+ */
+static size_t computeNumWorkers(size_t numCPUs) {
+  size_t numWorkers = numCPUs;
+  size_t quota = computeCPUQuota();
+  if (quota > 0 && quota < numWorkers) numWorkers = quota;
+
+  ifstream loadavg(kLoadAverageFile.c_str());
+  double load;
+  long onlineCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+  if (loadavg >> load && onlineCPUs > 0) {
+    // The load average covers the whole machine; charge us our share of it.
+    double idle = numCPUs - load * numCPUs / onlineCPUs;
+    size_t spare = idle < 1 ? 1 : ceil(idle - 0.5);
+    if (spare < numWorkers) numWorkers = spare;
+  }
 
-static void waitForAllWorkers() {
-  sigset_t mask, mask_o;
-  sigemptyset(&mask_o);
-  sigaddset(&mask_o, SIGCHLD);
-  sigprocmask(SIG_BLOCK, &mask_o, &mask);
-  while(numWorkersAvailable < kNumCPUs)
-    sigsuspend(&mask);
-  sigprocmask(SIG_UNBLOCK, &mask_o, NULL);
+  if (numWorkers == 0) numWorkers = 1;
+  return numWorkers;
 }
 
-static void closeAllWorkers() {
-  signal(SIGCHLD, SIG_DFL);
-
-  for (worker w : workers)
-  {
-    kill(w.sp.pid, SIGCONT);
-    close(w.sp.supplyfd);
+static void pinWorker(pid_t pid, size_t slot) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pinWorkers) {
+    CPU_SET(placement[slot], &cpu_set);
+  } else {
+    for (int cpu: placement) CPU_SET(cpu, &cpu_set);
   }
+  if (sched_setaffinity(pid, sizeof(cpu_set), &cpu_set) < 0)
+    perror("sched_setaffinity");
 
-  for (worker w: workers)
-  {
-    waitpid(w.sp.pid, NULL, 0);
+  if (pinWorkers)
+    printf("Worker %d is set to run on CPU %d\n", pid, placement[slot]);
+  else
+    printf("Worker %d is free to run on any of %zu CPUs\n", pid, placement.size());
+}
+
+static bool readNumber(long long& num) {
+  string line;
+  getline(cin, line);
+  if (cin.fail()) return false;
+  size_t endpos;
+  num = stoll(line, &endpos);
+  return endpos == line.size();
+}
+
+static void broadcastNumbersToWorkers(ProcessPool& pool) {
+  long long num;
+  while (readNumber(num)) {
+    while (reorderBuffer.size() >= kReorderCapacity)
+      pool.poll();
+    reorderBuffer.push_back({false, ""});
+    pool.schedule(to_string(num));
   }
 }
 
 int main(int argc, char *argv[]) {
-	signal(SIGCHLD, markWorkersAsAvailable);
-	spawnAllWorkers();
-	broadcastNumbersToWorkers();
-	waitForAllWorkers();
-	closeAllWorkers();
-	return 0;
+  signal(SIGPIPE, SIG_IGN);
+  char *workerArgv[] = {const_cast<char *>(kExecutable.c_str()), NULL};
+  placement = computePlacement();
+  size_t numWorkers = computeNumWorkers(placement.size());
+  pinWorkers = numWorkers == placement.size();
+  if (!pinWorkers) placement.resize(numWorkers);
+  ProcessPool pool(workerArgv, numWorkers);
+  pool.setResultHandler(recordAnswer);
+  pool.setLaunchHandler(pinWorker);
+  try {
+    pool.start();
+    broadcastNumbersToWorkers(pool);
+    pool.shutdown();
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while running the workers: " << se.what() << endl;
+    return 1;
+  }
+  return 0;
 }
@@ -0,0 +1,90 @@
+/**
+ * File: pipeline-bench.c
+ * ----------------------
+ * Measures throughput through a chain of cat stages built by runPipeline,
+ * fed from a scratch file and drained into /dev/null, for a range of pipe
+ * sizes.  Long chains of small pipes spend most of their time context
+ * switching; bigger pipes let every stage move more per wakeup.
+ *
+ *    > ./pipeline-bench [megabytes] [stages] [pipe-size-kb ...]
+ */
+
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const size_t kDefaultMegabytes = 512;
+static const size_t kDefaultStages = 6;
+static const int kDefaultPipeSizesKB[] = {64, 256, 1024};
+static const size_t kNumDefaultPipeSizes = sizeof(kDefaultPipeSizesKB)/sizeof(kDefaultPipeSizesKB[0]);
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Function: createScratchFile
+ * ---------------------------
+ * Writes megabytes of non-repeating data to a fresh temporary file and
+ * places its name in path.  Returns 0 on success and -1 on error.
+ */
+static int createScratchFile(char *path, size_t megabytes) {
+  int fd = mkstemp(path);
+  if (fd < 0) return -1;
+  static unsigned long block[(1 << 20) / sizeof(unsigned long)];
+  size_t numWords = sizeof(block)/sizeof(block[0]);
+  for (size_t mb = 0; mb < megabytes; mb++) {
+    for (size_t i = 0; i < numWords; i++) block[i] = mb * numWords + i;
+    if (write(fd, block, sizeof(block)) != (ssize_t) sizeof(block)) {
+      close(fd);
+      return -1;
+    }
+  }
+  return close(fd);
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultMegabytes;
+  size_t numStages = argc > 2 ? strtoul(argv[2], NULL, 10) : kDefaultStages;
+  if (megabytes == 0 || numStages == 0) {
+    fprintf(stderr, "Usage: %s [megabytes] [stages] [pipe-size-kb ...]\n", argv[0]);
+    return 1;
+  }
+
+  char path[] = "/tmp/pipeline-bench-XXXXXX";
+  if (createScratchFile(path, megabytes) < 0) {
+    perror("Couldn't create scratch file");
+    return 1;
+  }
+
+  char *cat[] = {"cat", NULL};
+  char **stages[numStages];
+  for (size_t i = 0; i < numStages; i++) stages[i] = cat;
+  pid_t pids[numStages];
+
+  printf("%zu MB through %zu cat stages\n", megabytes, numStages);
+  printf("%15s%15s\n", "pipe (KB)", "MB/sec");
+  int result = 0;
+  for (int i = 3; i < argc || (argc <= 3 && (size_t) (i - 3) < kNumDefaultPipeSizes); i++) {
+    int kilobytes = argc > 3 ? atoi(argv[i]) : kDefaultPipeSizesKB[i - 3];
+    struct pipelineOptions options = {path, "/dev/null", kilobytes << 10};
+    double start = now();
+    int status = runPipeline(stages, numStages, &options, pids);
+    double elapsed = now() - start;
+    if (status != 0) {
+      fprintf(stderr, "Pipeline failed (status %d).\n", status);
+      result = 1;
+      break;
+    }
+    printf("%15d%15.0f\n", kilobytes, megabytes / elapsed);
+  }
+
+  unlink(path);
+  return result;
+}
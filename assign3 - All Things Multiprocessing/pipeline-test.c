@@ -7,10 +7,39 @@
 
 #include "pipeline.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <sys/wait.h>
 
+static const size_t kNumInputLines = 100;
+static char inputFile[] = "/tmp/pipeline-test-in-XXXXXX";
+
+/**
+ * Function: createInputFile
+ * -------------------------
+ * Writes kNumInputLines numbered lines to a fresh temporary file named by
+ * inputFile, so every test reads the same known input.  Returns 0 on success
+ * and -1 on error, in which case no file is left behind.
+ */
+static int createInputFile() {
+  int fd = mkstemp(inputFile);
+  if (fd < 0) return -1;
+  FILE *stream = fdopen(fd, "w");
+  if (stream == NULL) {
+    close(fd);
+    unlink(inputFile);
+    return -1;
+  }
+  for (size_t i = 1; i <= kNumInputLines; i++)
+    fprintf(stream, "line %03zu of the pipeline test input\n", i);
+  if (fclose(stream) != 0) {
+    unlink(inputFile);
+    return -1;
+  }
+  return 0;
+}
+
 static void printArgumentVector(char *argv[]) {
   if (argv == NULL || *argv == NULL) {
     printf("<empty>");
@@ -42,12 +71,78 @@ static void launchPipedExecutables(char *argv1[], char *argv2[]) {
 }
 
 static void simpleTest() {
-  char *argv1[] = {"cat", "/usr/include/tar.h", NULL};
+  char *argv1[] = {"cat", inputFile, NULL};
   char *argv2[] = {"wc", NULL};
   launchPipedExecutables(argv1, argv2);
 }
 
+static void summarizeStages(char **stages[], size_t numStages) {
+  printf("Pipeline: ");
+  for (size_t i = 0; i < numStages; i++) {
+    if (i > 0) printf(" -> ");
+    printArgumentVector(stages[i]);
+  }
+  printf("\n");
+}
+
+static void launchStages(char **stages[], size_t numStages, const struct pipelineOptions *options) {
+  summarizeStages(stages, numStages);
+  fflush(stdout);
+  pid_t pids[numStages];
+  int status = runPipeline(stages, numStages, options, pids);
+  if (status < 0) perror("runPipeline");
+  else if (WIFEXITED(status)) printf("Aggregate status: exited with %d\n", WEXITSTATUS(status));
+  else printf("Aggregate status: 0x%x\n", status);
+}
+
+static void multiStageTest() {
+  char *cat[] = {"cat", NULL};
+  char *sort[] = {"sort", "-r", NULL};
+  char *head[] = {"head", "-5", NULL};
+  char *wc[] = {"wc", NULL};
+  char **stages[] = {cat, cat, sort, cat, head, cat, wc};
+  struct pipelineOptions options = {inputFile, NULL, 1 << 20};
+  launchStages(stages, sizeof(stages)/sizeof(stages[0]), &options);
+}
+
+static void fileToFileTest() {
+  char outputFile[] = "/tmp/pipeline-test-out-XXXXXX";
+  int fd = mkstemp(outputFile);
+  if (fd < 0) {
+    perror("Couldn't create output file");
+    return;
+  }
+  close(fd);
+
+  char *cat[] = {"cat", NULL};
+  char *cmp[] = {"cmp", inputFile, outputFile, NULL};
+  char **stages[] = {cat, cat, cat};
+  struct pipelineOptions options = {inputFile, outputFile, 0};
+  launchStages(stages, 3, &options);
+  char **check[] = {cmp};
+  struct pipelineOptions none = {NULL, NULL, 0};
+  launchStages(check, 1, &none);
+  unlink(outputFile);
+}
+
+static void failingStageTest() {
+  char *cat[] = {"cat", NULL};
+  char *fail[] = {"sh", "-c", "exit 3", NULL};
+  char *head[] = {"head", "-c", "10", NULL};
+  char **stages[] = {fail, cat, head};
+  struct pipelineOptions options = {inputFile, "/dev/null", 0};
+  launchStages(stages, 3, &options);
+}
+
 int main(int argc, char *argv[]) {
+  if (createInputFile() < 0) {
+    perror("Couldn't create input file");
+    return 1;
+  }
   simpleTest();
+  multiStageTest();
+  fileToFileTest();
+  failingStageTest();
+  unlink(inputFile);
   return 0;
 }
@@ -1,33 +1,310 @@
 /**
  * File: pipeline.c
  * ----------------
- * Presents the implementation of the pipeline routine.
+ * Presents the implementation of the pipeline and runPipeline routines.
  */
 
+#define _GNU_SOURCE
 #include "pipeline.h"
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+static const size_t kSpliceChunk = 1 << 20;
+static const char *const kPipeMaxSizeFile = "/proc/sys/fs/pipe-max-size";
+
+/**
+ * Function: resizePipe
+ * --------------------
+ * Raises the capacity of the pipe behind fd to size bytes, clamped to the
+ * most an unprivileged process may ask for.  Best effort: on failure the
+ * pipe just keeps its current size.
+ */
+static void resizePipe(int fd, int size) {
+  static int maxSize = 0;
+  if (size <= 0) return;
+  if (maxSize == 0) {
+    FILE *fp = fopen(kPipeMaxSizeFile, "r");
+    if (fp == NULL || fscanf(fp, "%d", &maxSize) != 1) maxSize = 1 << 20;
+    if (fp != NULL) fclose(fp);
+  }
+  fcntl(fd, F_SETPIPE_SZ, size < maxSize ? size : maxSize);
+}
+
+/**
+ * Function: spawnStage
+ * --------------------
+ * Launches argv with its stdin and stdout rewired to in and out.  Every
+ * pipe is created with O_CLOEXEC, so the stage doesn't hold on to any pipe
+ * end other than its own two.  Returns 0 on success and an error number
+ * otherwise.
+ */
+static int spawnStage(char *argv[], int in, int out, pid_t *pid) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (in != STDIN_FILENO)
+    posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+  if (out != STDOUT_FILENO)
+    posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+  int err = posix_spawnp(pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    fprintf(stderr, "Couldn't launch %s: %s\n", argv[0], strerror(err));
+    *pid = -1;
+  }
+  return err;
+}
+
+/**
+ * Function: launchStages
+ * ----------------------
+ * Launches every stage, connecting neighbors with pipes of the given size.
+ * The first stage reads from firstIn and the last writes to lastOut.  On
+ * failure, returns -1 with errno set, and pids holds -1 for every stage
+ * that isn't running.
+ */
+static int launchStages(char **stages[], size_t numStages, int firstIn, int lastOut,
+                        int pipeSize, pid_t pids[]) {
+  for (size_t i = 0; i < numStages; i++) pids[i] = -1;
+
+  int in = firstIn;
+  int err = 0;
+  for (size_t i = 0; i < numStages && err == 0; i++) {
+    int fds[2] = {-1, -1};
+    int out = lastOut;
+    if (i + 1 < numStages) {
+      if (pipe2(fds, O_CLOEXEC) < 0) {
+        err = errno;
+        break;
+      }
+      resizePipe(fds[1], pipeSize);
+      out = fds[1];
+    }
+
+    err = spawnStage(stages[i], in, out, &pids[i]);
+    if (in != firstIn) close(in);
+    if (fds[1] != -1) close(fds[1]);
+    in = fds[0];
+  }
+
+  if (in != firstIn && in != -1) close(in);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
 
 void pipeline(char *argv1[], char *argv2[], pid_t pids[]) {
+  char **stages[] = {argv1, argv2};
+  launchStages(stages, 2, STDIN_FILENO, STDOUT_FILENO, 0, pids);
+}
+
+/**
+ * Type: endpoint
+ * --------------
+ * Connects one of runPipeline's files to the pipe at its end of the
+ * pipeline.  The pipe end is nonblocking, so the only thing that can make a
+ * transfer wait is the pipe, and that's the descriptor we poll.  If the
+ * output file can't be spliced into (it was opened for appending, say, or
+ * it's a terminal), the endpoint falls back to read and write.
+ */
+struct endpoint {
+  int file;
+  int pipe;
+  bool intoPipe;
+  bool copy;
+  bool open;
+};
+
+/**
+ * Function: transfer
+ * ------------------
+ * Moves as much as it can through e without blocking.  Returns 1 once e is
+ * finished (the source hit EOF, or the first stage stopped reading), 0 if
+ * it has to wait on its pipe, and -1 on error.
+ */
+static int transfer(struct endpoint *e) {
+  int src = e->intoPipe ? e->file : e->pipe;
+  int dst = e->intoPipe ? e->pipe : e->file;
+  char buffer[1 << 16];
+  while (true) {
+    ssize_t n;
+    if (e->copy) {
+      n = read(src, buffer, sizeof(buffer));
+      for (ssize_t written = 0; n > 0 && written < n; ) {
+        ssize_t w = write(dst, buffer + written, n - written);
+        if (w < 0 && errno != EINTR) return -1;
+        if (w > 0) written += w;
+      }
+    } else {
+      n = splice(src, NULL, dst, NULL, kSpliceChunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    }
+
+    if (n > 0) continue;
+    if (n == 0 || errno == EPIPE) return 1;
+    if (errno == EAGAIN) return 0;
+    if (errno == EINTR) continue;
+    if (errno == EINVAL && !e->copy && !e->intoPipe) {
+      e->copy = true;
+      continue;
+    }
+    return -1;
+  }
+}
+
+/**
+ * Function: pumpEndpoints
+ * -----------------------
+ * Runs every open endpoint to completion, polling their pipes, and closes
+ * each pipe as its endpoint finishes.  SIGPIPE is blocked throughout, and
+ * any SIGPIPE the first stage's early exit raises is discarded before the
+ * caller's signal mask is restored.  Returns 0 on success and -1 on error.
+ */
+static int pumpEndpoints(struct endpoint ends[], int numEnds) {
+  sigset_t pipeMask, existingMask, pending;
+  sigemptyset(&pipeMask);
+  sigaddset(&pipeMask, SIGPIPE);
+  sigpending(&pending);
+  bool alreadyPending = sigismember(&pending, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeMask, &existingMask);
+
+  int result = 0, savedErrno = 0;
+  while (true) {
+    struct pollfd fds[2];
+    int owners[2];
+    int numFds = 0;
+    for (int i = 0; i < numEnds; i++) {
+      if (!ends[i].open) continue;
+      fds[numFds].fd = ends[i].pipe;
+      fds[numFds].events = ends[i].intoPipe ? POLLOUT : POLLIN;
+      owners[numFds++] = i;
+    }
+    if (numFds == 0) break;
+    if (poll(fds, numFds, -1) < 0) {
+      if (errno == EINTR) continue;
+      result = -1;
+      savedErrno = errno;
+      break;
+    }
+
+    for (int k = 0; k < numFds; k++) {
+      if (fds[k].revents == 0) continue;
+      struct endpoint *e = &ends[owners[k]];
+      int status = transfer(e);
+      if (status == 0) continue;
+      if (status < 0) {
+        result = -1;
+        savedErrno = errno;
+      }
+      close(e->pipe);
+      e->open = false;
+    }
+    if (result < 0) break;
+  }
+
+  for (int i = 0; i < numEnds; i++)
+    if (ends[i].open) close(ends[i].pipe);
+
+  sigpending(&pending);
+  if (!alreadyPending && sigismember(&pending, SIGPIPE)) {
+    struct timespec immediately = {0, 0};
+    sigtimedwait(&pipeMask, NULL, &immediately);
+  }
+  pthread_sigmask(SIG_SETMASK, &existingMask, NULL);
+  errno = savedErrno;
+  return result;
+}
+
+/**
+ * Function: openEndpoint
+ * ----------------------
+ * Opens path and a pipe for it, handing the child's end of the pipe back
+ * through childEnd.  Returns 0 on success and -1 (with errno set) on error.
+ */
+static int openEndpoint(struct endpoint *e, const char *path, bool intoPipe, int pipeSize, int *childEnd) {
   int fds[2];
-  pipe(fds);
-  pids[0] = fork();
-  if ( pids[0] == 0 )
-  {
-    close(fds[0]);
-    dup2(fds[1], STDOUT_FILENO);
-    execvp( argv1[0], argv1);  
-    fprintf(stderr, "Child process should not reach execution here\n");
-  }
-  pids[1] = fork();
-  if ( pids[1] == 0 )
-  {
-    close(fds[1]); 
-    dup2(fds[0], STDIN_FILENO);
-    execvp( argv2[0], argv2);  
-    fprintf(stderr, "Child process should not reach execution here\n");
-  }
-  close(fds[1]);
-  close(fds[0]);
+  e->intoPipe = intoPipe;
+  e->copy = false;
+  e->open = false;
+  e->file = intoPipe ? open(path, O_RDONLY | O_CLOEXEC) :
+                       open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (e->file < 0) return -1;
+  if (pipe2(fds, O_CLOEXEC) < 0) {
+    int err = errno;
+    close(e->file);
+    errno = err;
+    return -1;
+  }
+
+  resizePipe(fds[0], pipeSize);
+  e->pipe = intoPipe ? fds[1] : fds[0];
+  *childEnd = intoPipe ? fds[0] : fds[1];
+  fcntl(e->pipe, F_SETFL, fcntl(e->pipe, F_GETFL) | O_NONBLOCK);
+  e->open = true;
+  return 0;
+}
+
+int runPipeline(char **stages[], size_t numStages, const struct pipelineOptions *options, pid_t pids[]) {
+  if (numStages == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct endpoint ends[2];
+  int numEnds = 0;
+  int firstIn = STDIN_FILENO, lastOut = STDOUT_FILENO;
+  int err = 0;
+  if (options->inputFile != NULL) {
+    if (openEndpoint(&ends[numEnds], options->inputFile, true, options->pipeSize, &firstIn) < 0)
+      err = errno;
+    else
+      numEnds++;
+  }
+  if (err == 0 && options->outputFile != NULL) {
+    if (openEndpoint(&ends[numEnds], options->outputFile, false, options->pipeSize, &lastOut) < 0)
+      err = errno;
+    else
+      numEnds++;
+  }
+
+  for (size_t i = 0; i < numStages; i++) pids[i] = -1;
+  if (err == 0 && launchStages(stages, numStages, firstIn, lastOut, options->pipeSize, pids) < 0)
+    err = errno;
+  if (firstIn != STDIN_FILENO) close(firstIn);
+  if (lastOut != STDOUT_FILENO) close(lastOut);
+
+  // If some stage didn't start, closing the pipes is enough to bring the rest down.
+  if (err != 0) {
+    for (int i = 0; i < numEnds; i++) close(ends[i].pipe);
+  } else if (pumpEndpoints(ends, numEnds) < 0) {
+    err = errno;
+  }
+  for (int i = 0; i < numEnds; i++) close(ends[i].file);
+
+  int aggregate = 0;
+  for (size_t i = 0; i < numStages; i++) {
+    if (pids[i] == -1) continue;
+    int status;
+    pid_t reaped;
+    do {
+      reaped = waitpid(pids[i], &status, 0);
+    } while (reaped < 0 && errno == EINTR);
+    if (reaped == pids[i] && status != 0) aggregate = status;
+  }
+
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return aggregate;
 }
@@ -4,8 +4,10 @@
  * Exports the pipeline routine, which launches
  * two sister executables such that the standout
  * output of the first is routed to the standard
- * input of the second.  Check out the following
- * test framework to see how pipeline should work:
+ * input of the second, and runPipeline, which does
+ * the same for any number of executables.  Check out
+ * the following test framework to see how pipeline
+ * should work:
 
      int main(int argc, char *argv[]) {
        char *argv1[] = {"cat", "pipeline-test.c", NULL};
@@ -23,6 +25,7 @@
 #ifndef _pipeline_h_
 #define _pipeline_h_
 
+#include <stddef.h>
 #include <unistd.h>
 
 /**
@@ -38,4 +41,43 @@
 
 void pipeline(char *argv1[], char *argv2[], pid_t pids[]);
 
+/**
+ * Type: pipelineOptions
+ * ---------------------
+ * Configures runPipeline below.
+ *
+ *  inputFile: file fed to the first stage's stdin, or NULL if the first stage
+ *             should simply inherit ours
+ *  outputFile: file (created or truncated) receiving the last stage's stdout, or
+ *              NULL if the last stage should simply inherit ours
+ *  pipeSize: capacity every pipe is raised to via F_SETPIPE_SZ, clamped to
+ *            /proc/sys/fs/pipe-max-size, or 0 to keep the kernel default (64KiB)
+ */
+struct pipelineOptions {
+  const char *inputFile;
+  const char *outputFile;
+  int pipeSize;
+};
+
+/**
+ * Function: runPipeline
+ * ---------------------
+ * Generalizes pipeline to any number of stages: launches stages[0] through
+ * stages[numStages - 1] (each a NULL-terminated argument vector), routes the
+ * standard output of each to the standard input of the next, and places
+ * their process ids in pids[0] through pids[numStages - 1].
+ *
+ * The input and output files are moved to and from the end pipes by the
+ * calling process with splice, so file data never passes through user space.
+ * runPipeline pumps the files while the stages run, reaps every stage, and
+ * returns an aggregate wait status: that of the rightmost stage that didn't
+ * exit with status 0, or the last stage's if they all did (like bash's
+ * pipefail).  Returns -1 (with errno set) if the pipeline couldn't be
+ * started; any stages already running are still reaped.
+ *
+ * If a stage stops reading early, the input file is simply abandoned, and
+ * the SIGPIPE that raises in the calling process is discarded.
+ */
+int runPipeline(char **stages[], size_t numStages, const struct pipelineOptions *options, pid_t pids[]);
+
 #endif
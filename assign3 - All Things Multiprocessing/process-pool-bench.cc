@@ -0,0 +1,75 @@
+/**
+ * File: process-pool-bench.cc
+ * ---------------------------
+ * Measures ProcessPool throughput by pushing trivial tasks through a pool of
+ * echo workers (/bin/cat answers each line with itself), so the numbers
+ * reflect dispatch and result-collection overhead rather than real work.
+ *
+ *    > ./process-pool-bench [num-tasks] [num-workers ...]
+ */
+
+#include "process-pool.h"
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+static const size_t kDefaultNumTasks = 200000;
+static const string kEchoExecutable = "/bin/cat";
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Function: measureThroughput
+ * ---------------------------
+ * Returns the number of tasks per second a pool of numWorkers echo workers
+ * gets through, and confirms every task came back with its own text.
+ */
+static double measureThroughput(size_t numWorkers, size_t numTasks) {
+  char *argv[] = {const_cast<char *>(kEchoExecutable.c_str()), NULL};
+  size_t numAnswered = 0, numWrong = 0;
+  double start = now();
+  {
+    ProcessPool pool(argv, numWorkers);
+    pool.setResultHandler([&](size_t id, const string& result) {
+      numAnswered++;
+      if (result != to_string(id)) numWrong++;
+    });
+    for (size_t i = 0; i < numTasks; i++) pool.schedule(to_string(i));
+    pool.wait();
+  }
+  double elapsed = now() - start;
+  if (numAnswered != numTasks || numWrong > 0)
+    cerr << "Expected " << numTasks << " echoes, got " << numAnswered
+         << " (" << numWrong << " wrong)." << endl;
+  return numTasks / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+  signal(SIGPIPE, SIG_IGN);
+  size_t numTasks = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultNumTasks;
+  vector<size_t> counts;
+  for (int i = 2; i < argc; i++) counts.push_back(strtoul(argv[i], NULL, 10));
+  if (counts.empty()) {
+    size_t numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    for (size_t n = 1; n < numCPUs; n *= 2) counts.push_back(n);
+    counts.push_back(numCPUs);
+  }
+
+  cout << setw(10) << "workers" << setw(16) << "tasks/sec" << endl;
+  try {
+    for (size_t n: counts)
+      cout << setw(10) << n << setw(16) << fixed << setprecision(0) << measureThroughput(n, numTasks) << endl;
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while running the pool: " << se.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,301 @@
+/**
+ * File: process-pool.cc
+ * ---------------------
+ * Presents the implementation of the ProcessPool class.
+ */
+
+#include "process-pool.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+using namespace std;
+
+/**
+ * Batches are sized so each one takes roughly kTargetBatchSeconds of worker
+ * time, based on a running average of how long a single task takes.  The
+ * cap keeps one worker from sitting on a long tail of the queue.
+ */
+static const double kTargetBatchSeconds = 0.005;
+static const size_t kMaxBatchSize = 64;
+static const double kServiceTimeWeight = 0.25;
+
+static const size_t kMaxQueuedTasks = 1024;
+static const size_t kMaxTaskAttempts = 3;
+static const double kIdleRetireSeconds = 1.0;
+static const int kIdleCheckMillis = 250;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+ProcessPool::ProcessPool(char *argv[], size_t minWorkers, size_t maxWorkers) :
+  minWorkers(minWorkers), maxWorkers(maxWorkers < minWorkers ? minWorkers : maxWorkers),
+  numWorkersAlive(0), numWorkersBusy(0), nextId(0), avgServiceSeconds(0),
+  epfd(-1), started(false), shuttingDown(false) {
+  for (size_t i = 0; argv[i] != NULL; i++) this->argv.push_back(argv[i]);
+}
+
+/**
+ * The destructor may run while an exception is unwinding out of schedule or
+ * shutdown, so it mustn't drain the queue (which can throw).  Instead it
+ * closes the workers' stdin, kills whichever workers are still alive, and
+ * reaps them.
+ */
+ProcessPool::~ProcessPool() {
+  if (!started) return;
+  for (worker& w: workers) {
+    if (!w.alive) continue;
+    if (!w.retiring && !shuttingDown) close(w.sp.supplyfd);
+    close(w.sp.ingestfd);
+    kill(w.sp.pid, SIGKILL);
+    while (waitpid(w.sp.pid, NULL, 0) < 0 && errno == EINTR);
+    w.alive = false;
+  }
+  if (epfd >= 0) close(epfd);
+}
+
+void ProcessPool::start() {
+  if (started) return;
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0) throw SubprocessException("Error with epoll_create1()");
+  started = true;
+  for (size_t i = 0; i < minWorkers; i++) growPool();
+}
+
+size_t ProcessPool::schedule(const string& text) {
+  start();
+  size_t id = nextId++;
+  queue.push_back({id, text, 0});
+  dispatch();
+  while (queue.size() >= kMaxQueuedTasks) poll();
+  return id;
+}
+
+void ProcessPool::poll() {
+  dispatch();
+  if (numWorkersBusy == 0) return;
+  processEvents(maxWorkers > minWorkers ? kIdleCheckMillis : -1);
+  retireIdleWorkers();
+  dispatch();
+}
+
+void ProcessPool::wait() {
+  while (numWorkersBusy > 0 || !queue.empty()) poll();
+}
+
+void ProcessPool::shutdown() {
+  if (!started || shuttingDown) return;
+  wait();
+  shuttingDown = true;
+  for (worker& w: workers)
+    if (w.alive && !w.retiring) close(w.sp.supplyfd);
+
+  // Workers exit once they see EOF; reap them as their output closes.
+  while (numWorkersAlive > 0) processEvents(-1);
+  close(epfd);
+  epfd = -1;
+}
+
+/**
+ * Starts a worker process in the given slot, registers its output with
+ * epoll, and marks it idle.
+ */
+void ProcessPool::spawnWorker(size_t slot) {
+  vector<char *> args;
+  for (string& arg: argv) args.push_back(const_cast<char *>(arg.c_str()));
+  args.push_back(NULL);
+
+  worker& w = workers[slot];
+  w.sp = subprocess(args.data(), true, true);
+  w.alive = true;
+  w.retiring = false;
+  w.inflight.clear();
+  w.pending.clear();
+  w.batchSize = 0;
+  w.batchStart = 0;
+  w.idleSince = now();
+
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = slot;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, w.sp.ingestfd, &event) < 0)
+    throw SubprocessException("Error with epoll_ctl()");
+
+  numWorkersAlive++;
+  idleWorkers.push_back(slot);
+  if (launchHandler) launchHandler(w.sp.pid, slot);
+}
+
+/**
+ * Spawns one more worker, reusing the lowest free slot.
+ */
+void ProcessPool::growPool() {
+  size_t slot = 0;
+  while (slot < workers.size() && workers[slot].alive) slot++;
+  if (slot == workers.size()) workers.push_back(worker());
+  spawnWorker(slot);
+}
+
+/**
+ * Hands batches of queued tasks to idle workers, growing the pool if tasks
+ * are waiting and there's room to.
+ */
+void ProcessPool::dispatch() {
+  while (!queue.empty()) {
+    if (idleWorkers.empty()) {
+      if (numWorkersAlive >= maxWorkers) return;
+      growPool();
+    }
+
+    size_t slot = idleWorkers.back();
+    idleWorkers.pop_back();
+    const worker& w = workers[slot];
+    if (!w.alive || w.retiring || !w.inflight.empty()) continue;
+    sendBatch(slot);
+  }
+}
+
+void ProcessPool::sendBatch(size_t slot) {
+  worker& w = workers[slot];
+  size_t count = min(computeBatchSize(), queue.size());
+  string batch;
+  for (size_t k = 0; k < count; k++) {
+    batch += queue.front().text;
+    batch += '\n';
+    w.inflight.push_back(queue.front());
+    queue.pop_front();
+  }
+
+  w.batchSize = count;
+  w.batchStart = now();
+  numWorkersBusy++;
+
+  // A failed write means the worker died; its EOF requeues the batch.
+  size_t written = 0;
+  while (written < batch.size()) {
+    ssize_t n = write(w.sp.supplyfd, batch.data() + written, batch.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += n;
+  }
+}
+
+size_t ProcessPool::computeBatchSize() const {
+  if (avgServiceSeconds == 0) return 1;
+  double size = kTargetBatchSeconds / avgServiceSeconds;
+  if (size < 1) return 1;
+  if (size > kMaxBatchSize) return kMaxBatchSize;
+  return size;
+}
+
+void ProcessPool::recordBatchServiceTime(const worker& w) {
+  double sample = (now() - w.batchStart) / w.batchSize;
+  if (avgServiceSeconds == 0)
+    avgServiceSeconds = sample;
+  else
+    avgServiceSeconds += kServiceTimeWeight * (sample - avgServiceSeconds);
+}
+
+/**
+ * Matches every complete line the worker in slot has produced with the
+ * oldest task it still owes, marking the worker idle once its whole batch
+ * has been answered.  Returns false once the worker's output has closed.
+ */
+bool ProcessPool::ingestFromWorker(size_t slot) {
+  worker& w = workers[slot];
+  char buf[4096];
+  ssize_t n;
+  do {
+    n = read(w.sp.ingestfd, buf, sizeof(buf));
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) return false;
+
+  w.pending.append(buf, n);
+  size_t start = 0, end;
+  while ((end = w.pending.find('\n', start)) != string::npos) {
+    string line = w.pending.substr(start, end - start);
+    start = end + 1;
+    if (w.inflight.empty()) continue; // not an answer to anything we asked
+
+    size_t id = w.inflight.front().id;
+    w.inflight.pop_front();
+    if (w.inflight.empty()) {
+      recordBatchServiceTime(w);
+      numWorkersBusy--;
+      w.idleSince = now();
+      idleWorkers.push_back(slot);
+    }
+    if (resultHandler) resultHandler(id, line);
+  }
+  w.pending.erase(0, start);
+  return true;
+}
+
+/**
+ * Reaps the worker in slot once its output closes.  Unless we asked it to
+ * leave, the worker crashed: whatever it still owed goes back to the front
+ * of the queue and a replacement is started in the same slot.
+ */
+void ProcessPool::handleWorkerExit(size_t slot) {
+  worker& w = workers[slot];
+  epoll_ctl(epfd, EPOLL_CTL_DEL, w.sp.ingestfd, NULL);
+  close(w.sp.ingestfd);
+  if (!w.retiring && !shuttingDown) close(w.sp.supplyfd);
+  waitpid(w.sp.pid, NULL, 0);
+  w.alive = false;
+  numWorkersAlive--;
+
+  if (!w.inflight.empty()) {
+    numWorkersBusy--;
+    while (!w.inflight.empty()) {
+      task t = w.inflight.back();
+      w.inflight.pop_back();
+      if (++t.attempts < kMaxTaskAttempts) {
+        queue.push_front(t);
+        continue;
+      }
+      fprintf(stderr, "Abandoning task %zu after %zu attempts.\n", t.id, t.attempts);
+      if (resultHandler) resultHandler(t.id, "");
+    }
+  }
+
+  if (w.retiring || shuttingDown) return;
+  fprintf(stderr, "Worker %d exited unexpectedly; restarting it.\n", w.sp.pid);
+  spawnWorker(slot);
+}
+
+/**
+ * Closes the stdin of workers beyond minWorkers that have been idle for
+ * kIdleRetireSeconds; they're reaped when their output closes.
+ */
+void ProcessPool::retireIdleWorkers() {
+  if (maxWorkers == minWorkers) return;
+  double cutoff = now() - kIdleRetireSeconds;
+  size_t numActive = 0;
+  for (const worker& w: workers)
+    if (w.alive && !w.retiring) numActive++;
+
+  for (worker& w: workers) {
+    if (numActive <= minWorkers) break;
+    if (!w.alive || w.retiring || !w.inflight.empty() || w.idleSince > cutoff) continue;
+    w.retiring = true;
+    close(w.sp.supplyfd);
+    numActive--;
+  }
+}
+
+void ProcessPool::processEvents(int timeout) {
+  vector<struct epoll_event> events(workers.size());
+  int n = epoll_wait(epfd, events.data(), events.size(), timeout);
+  if (n < 0 && errno != EINTR) throw SubprocessException("Error with epoll_wait()");
+
+  for (int e = 0; e < n; e++) {
+    size_t slot = events[e].data.u64;
+    if (!ingestFromWorker(slot)) handleWorkerExit(slot);
+  }
+}
@@ -0,0 +1,173 @@
+/**
+ * File: process-pool.h
+ * --------------------
+ * Exports the ProcessPool class, which keeps a set of worker processes
+ * running and feeds them a queue of tasks.
+ *
+ * Workers are spawned via subprocess and speak a line protocol: each task is
+ * written to a worker's stdin as one line, and the worker must answer every
+ * task with exactly one line on its stdout, in the order the tasks arrived.
+ * The pool hands each idle worker a batch of tasks at a time (sized from the
+ * measured per-task service time), multiplexes every worker's output with
+ * epoll, restarts workers that die, and requeues whatever they still owed.
+ *
+ * Sample program:
+
+static void printResult(size_t id, const string& result) {
+  cout << id << ": " << result << endl;
+}
+
+int main(int argc, char *argv[]) {
+  signal(SIGPIPE, SIG_IGN);
+  char *workerArgv[] = {const_cast<char *>("/bin/cat"), NULL};
+  ProcessPool pool(workerArgv, 4);
+  pool.setResultHandler(printResult);
+  for (const string& word: {"put", "a", "ring", "on", "it"})
+    pool.schedule(word);
+  pool.shutdown();
+  return 0;
+}
+
+ * Writes to a worker that has died raise SIGPIPE, so clients should ignore
+ * that signal.
+ */
+
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "subprocess.h"
+
+class ProcessPool {
+ public:
+/**
+ * Types: ResultHandler, LaunchHandler
+ * -----------------------------------
+ * A ResultHandler is invoked with a task's id and the worker's answer
+ * (without its trailing newline).  A task that keeps killing the workers
+ * it's handed to is abandoned and reported with an empty answer.
+ *
+ * A LaunchHandler is invoked every time a worker process is (re)started
+ * in a given slot, which is the place to pin it to a CPU.
+ */
+  typedef std::function<void(size_t id, const std::string& result)> ResultHandler;
+  typedef std::function<void(pid_t pid, size_t slot)> LaunchHandler;
+
+/**
+ * Constructor: ProcessPool
+ * ------------------------
+ * Configures a pool of workers running argv.  The pool keeps minWorkers
+ * processes alive and grows up to maxWorkers while tasks are waiting for
+ * a worker, retiring the extras once they've sat idle for a while.  A
+ * maxWorkers of 0 means the pool is fixed at minWorkers.  No processes are
+ * spawned until start (or the first schedule).
+ */
+  ProcessPool(char *argv[], size_t minWorkers, size_t maxWorkers = 0);
+
+/**
+ * Destructor: ~ProcessPool
+ * ------------------------
+ * Kills and reaps any workers that are still running, abandoning whatever
+ * tasks they haven't answered.  Never throws; call shutdown first to let
+ * the outstanding tasks finish.
+ */
+  ~ProcessPool();
+
+  void setResultHandler(const ResultHandler& handler) { resultHandler = handler; }
+  void setLaunchHandler(const LaunchHandler& handler) { launchHandler = handler; }
+
+/**
+ * Method: start
+ * -------------
+ * Spawns the initial minWorkers workers.  Throws a SubprocessException if
+ * a worker can't be spawned.
+ */
+  void start();
+
+/**
+ * Method: schedule
+ * ----------------
+ * Queues a task (which must not contain a newline) and returns its id.
+ * Ids are handed out consecutively from 0.  If the queue is full, schedule
+ * blocks, processing results, until there's room.
+ */
+  size_t schedule(const std::string& task);
+
+/**
+ * Method: poll
+ * ------------
+ * Hands queued tasks to idle workers, then blocks until at least one
+ * worker reports back and processes everything that's ready.  Returns
+ * immediately if no task is outstanding.
+ */
+  void poll();
+
+/**
+ * Method: wait
+ * ------------
+ * Blocks until every scheduled task has been answered.
+ */
+  void wait();
+
+/**
+ * Method: shutdown
+ * ----------------
+ * Waits for every scheduled task, closes every worker's stdin, and reaps
+ * the workers.  Throws a SubprocessException if anything goes wrong while
+ * waiting, in which case the destructor still cleans up.
+ */
+  void shutdown();
+
+  size_t getNumWorkers() const { return numWorkersAlive; }
+
+ private:
+  struct task {
+    size_t id;
+    std::string text;
+    size_t attempts;
+  };
+
+  struct worker {
+    subprocess_t sp;
+    bool alive;
+    bool retiring;
+    std::deque<task> inflight; // sent but not yet answered, oldest first
+    size_t batchSize;
+    double batchStart;
+    double idleSince;
+    std::string pending;       // partial line read back from the worker
+  };
+
+  std::vector<std::string> argv;
+  size_t minWorkers;
+  size_t maxWorkers;
+  ResultHandler resultHandler;
+  LaunchHandler launchHandler;
+
+  std::vector<worker> workers;
+  std::vector<size_t> idleWorkers;
+  std::deque<task> queue;
+  size_t numWorkersAlive;
+  size_t numWorkersBusy;
+  size_t nextId;
+  double avgServiceSeconds;
+  int epfd;
+  bool started;
+  bool shuttingDown;
+
+  void spawnWorker(size_t slot);
+  void growPool();
+  void dispatch();
+  void sendBatch(size_t slot);
+  size_t computeBatchSize() const;
+  void recordBatchServiceTime(const worker& w);
+  bool ingestFromWorker(size_t slot);
+  void handleWorkerExit(size_t slot);
+  void retireIdleWorkers();
+  void processEvents(int timeout);
+
+  ProcessPool(const ProcessPool& original) = delete;
+  ProcessPool& operator=(const ProcessPool& rhs) = delete;
+};
@@ -0,0 +1,69 @@
+/**
+ * File: subprocess-bench.cc
+ * -------------------------
+ * Measures how long subprocess takes to spawn (and reap) a trivial child under
+ * each SpawnStrategy as the parent's resident set grows.  fork has to copy the
+ * parent's page tables, so its cost climbs with RSS; posix_spawn shouldn't.
+ *
+ *    > ./subprocess-bench [iterations] [rss-mb ...]
+ */
+
+#include "subprocess.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <sys/wait.h>
+using namespace std;
+
+static const size_t kDefaultIterations = 200;
+static const size_t kDefaultRSSSizesMB[] = {0, 64, 256, 1024};
+static const string kTrueExecutable = "/bin/true";
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Function: measureSpawnLatency
+ * -----------------------------
+ * Returns the average number of microseconds needed to spawn and reap
+ * /bin/true with the supplied strategy.
+ */
+static double measureSpawnLatency(SpawnStrategy strategy, size_t iterations) {
+  char *argv[] = {const_cast<char *>(kTrueExecutable.c_str()), NULL};
+  double start = now();
+  for (size_t i = 0; i < iterations; i++) {
+    subprocess_t child = subprocess(argv, false, false, strategy);
+    waitpid(child.pid, NULL, 0);
+  }
+  return (now() - start) / iterations * 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  size_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultIterations;
+  vector<size_t> sizes;
+  for (int i = 2; i < argc; i++) sizes.push_back(strtoul(argv[i], NULL, 10));
+  if (sizes.empty()) sizes.assign(begin(kDefaultRSSSizesMB), end(kDefaultRSSSizesMB));
+
+  cout << setw(10) << "rss (MB)" << setw(18) << "fork+exec (us)" << setw(18) << "posix_spawn (us)" << endl;
+  try {
+    for (size_t mb: sizes) {
+      // Touch every page so the memory is actually resident and mapped.
+      vector<char> ballast(mb << 20);
+      memset(ballast.data(), 1, ballast.size());
+      double forked = measureSpawnLatency(kForkExec, iterations);
+      double spawned = measureSpawnLatency(kPosixSpawn, iterations);
+      cout << setw(10) << mb << fixed << setprecision(1)
+           << setw(18) << forked << setw(18) << spawned << endl;
+    }
+  } catch (const SubprocessException& se) {
+    cerr << "Problem encountered while spawning \"" << kTrueExecutable << "\": " << se.what() << endl;
+    return 1;
+  }
+  return 0;
+}
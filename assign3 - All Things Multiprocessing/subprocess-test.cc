@@ -8,6 +8,8 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
 #include <sys/wait.h>
 #include <ext/stdio_filebuf.h>
 
@@ -58,35 +60,93 @@ static void waitForChildProcess(pid_t pid) {
 	}
 }
 
+/**
+ * Function: exerciseAllConfigurations
+ * -----------------------------------
+ * Spawns /usr/bin/sort under every combination of supplyChildInput and
+ * ingestChildOutput using the provided spawn strategy.
+ */
+const string kSortExecutable = "/usr/bin/sort";
+static void exerciseAllConfigurations(SpawnStrategy strategy) {
+	char *argv[] = {const_cast<char *>(kSortExecutable.c_str()), NULL};
+	// true, true
+	subprocess_t child = subprocess(argv, true, true, strategy);
+	publishWordsToChild(child.supplyfd);
+	ingestAndPublishWords(child.ingestfd);
+	waitForChildProcess(child.pid);
+	// true, false
+	child = subprocess(argv, true, false, strategy);
+	publishWordsToChild(child.supplyfd);
+	ingestAndPublishWords(child.ingestfd);
+	waitForChildProcess(child.pid);
+	// false, true
+	child = subprocess(argv, false, true, strategy);
+	publishWordsToChild(child.supplyfd);
+	ingestAndPublishWords(child.ingestfd);
+	waitForChildProcess(child.pid);
+	// false, false
+	child = subprocess(argv, false, false, strategy);
+	publishWordsToChild(child.supplyfd);
+	ingestAndPublishWords(child.ingestfd);
+	waitForChildProcess(child.pid);
+}
+
+/**
+ * Function: exerciseCommunicate
+ * -----------------------------
+ * Round-trips several megabytes through /bin/cat (far more than a pipe holds,
+ * so feeding and draining have to overlap), captures stderr separately from
+ * stdout, and splices a file through /bin/cat into another file.
+ */
+const string kCatExecutable = "/bin/cat";
+static void exerciseCommunicate() {
+	char *catArgv[] = {const_cast<char *>(kCatExecutable.c_str()), NULL};
+	string input;
+	for (size_t i = 0; input.size() < (4 << 20); i++) input += to_string(i) + '\n';
+	string output, errors;
+	subprocess_t child = subprocess(catArgv, true, true);
+	int status = communicate(child, input, output, errors, 1 << 20);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || output != input || !errors.empty())
+		throw SubprocessException("communicate() didn't round-trip input through /bin/cat.");
+	if (child.supplyfd != kNotInUse || child.ingestfd != kNotInUse || child.errorfd != kNotInUse)
+		throw SubprocessException("communicate() left descriptors open.");
+
+	char *shArgv[] = {const_cast<char *>("/bin/sh"), const_cast<char *>("-c"),
+	                  const_cast<char *>("echo out; echo err 1>&2; exit 3"), NULL};
+	output.clear();
+	child = subprocess(shArgv, false, true, true);
+	status = communicate(child, "", output, errors);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 3 || output != "out\n" || errors != "err\n")
+		throw SubprocessException("communicate() didn't separate stdout from stderr.");
+
+	FILE *source = tmpfile();
+	FILE *sink = tmpfile();
+	fwrite(input.data(), 1, input.size(), source);
+	fflush(source);
+	rewind(source);
+	child = subprocess(catArgv, true, true);
+	status = communicate(child, fileno(source), fileno(sink), kNotInUse);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || ftell(sink) != (long) input.size())
+		throw SubprocessException("communicate() didn't splice a file through /bin/cat.");
+	rewind(sink);
+	string copy(input.size(), '\0');
+	if (fread(&copy[0], 1, copy.size(), sink) != copy.size() || copy != input)
+		throw SubprocessException("communicate() corrupted a file spliced through /bin/cat.");
+	fclose(source);
+	fclose(sink);
+	cout << "communicate() passed." << endl;
+}
+
 /**
  * Function: main
  * --------------
  * Serves as the entry point for for the unit test.
  */
-const string kSortExecutable = "/usr/bin/sort";
 int main(int argc, char *argv[]) {
 	try {
-    // true, true
-		char *argv[] = {const_cast<char *>(kSortExecutable.c_str()), NULL};
-		subprocess_t child = subprocess(argv, true, true);
-		publishWordsToChild(child.supplyfd);
-		ingestAndPublishWords(child.ingestfd);
-		waitForChildProcess(child.pid);
-		// true, false
-		child = subprocess(argv, true, false);
-		publishWordsToChild(child.supplyfd);
-		ingestAndPublishWords(child.ingestfd);
-		waitForChildProcess(child.pid);
-		// false, true
-		child = subprocess(argv, false, true);
-		publishWordsToChild(child.supplyfd);
-		ingestAndPublishWords(child.ingestfd);
-		waitForChildProcess(child.pid);
-		// false, false
-		child = subprocess(argv, false, false);
-		publishWordsToChild(child.supplyfd);
-		ingestAndPublishWords(child.ingestfd);
-		waitForChildProcess(child.pid);
+		exerciseAllConfigurations(kPosixSpawn);
+		exerciseAllConfigurations(kForkExec);
+		exerciseCommunicate();
 		return 0;
 	} catch (const SubprocessException& se) {
 		cerr << "Problem encountered while spawning second process to run \"" << kSortExecutable << "\"." << endl;
@@ -5,8 +5,18 @@
  */
 
 #include "subprocess.h"
+#include <cstring>
+#include <string>
+#include <cerrno>
+#include <csignal>
+#include <vector>
+#include <spawn.h>
+#include <poll.h>
+#include <sys/wait.h>
 using namespace std;
 
+extern char **environ;
+
 /**
  * Type: subprocess_t
  * ------------------
@@ -16,28 +26,44 @@ using namespace std;
  *  pid: the id of the child process created by a call to subprocess
  *  supplyfd: the descriptor where one pipes text to the child's stdin (or kNotInUse if child hasn't rewired its stdin)
  *  ingestfd: the descriptor where the text a child pushes to stdout shows up (or kNotInUse if child hasn't rewired its stdout)
+ *  errorfd: the descriptor where the text a child pushes to stderr shows up (or kNotInUse if child hasn't rewired its stderr)
  *
  */
 
+
 /**
- * Function: subprocess
- * --------------------
- * Creates a new process running the executable identified via argv[0].
- *
- *   argv: the NULL-terminated argument vector that should be passed to the new process's main function
- *   supplyChildInput: true if the parent process would like to pipe content to the new process's stdin, false otherwise
- *   ingestChildOutput: true if the parent would like the child's stdout to be pushed to the parent, false otheriwse
+ * Function: spawnWithPosixSpawn
+ * -----------------------------
+ * Launches argv with posix_spawnp, rewiring the child's stdin, stdout, and/or
+ * stderr to childIn, childOut, and childErr when they're in use.  Every pipe is
+ * created with O_CLOEXEC, so every pipe end the child shouldn't keep is closed
+ * for it at exec.
  */
-subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput) throw (SubprocessException) {
-  subprocess_t sp = {NULL, kNotInUse, kNotInUse};
-  int pipe_1[2];
-  int pipe_2[2];
+static pid_t spawnWithPosixSpawn(char *argv[], int childIn, int childOut, int childErr) throw (SubprocessException) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (childIn != kNotInUse)
+    posix_spawn_file_actions_adddup2(&actions, childIn, STDIN_FILENO);
+  if (childOut != kNotInUse)
+    posix_spawn_file_actions_adddup2(&actions, childOut, STDOUT_FILENO);
+  if (childErr != kNotInUse)
+    posix_spawn_file_actions_adddup2(&actions, childErr, STDERR_FILENO);
 
-  if ( pipe2(pipe_1, O_CLOEXEC) == -1 )
-    throw SubprocessException("Error with pipe2()");
-  if ( pipe2(pipe_2, O_CLOEXEC) == -1 )
-    throw SubprocessException("Error with pipe2()");
+  pid_t pid;
+  int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0)
+    throw SubprocessException(string("Error with posix_spawnp(): ") + strerror(err));
+  return pid;
+}
 
+/**
+ * Function: spawnWithForkExec
+ * ---------------------------
+ * Launches argv with a full fork and execvp, rewiring the child's standard
+ * descriptors the same way spawnWithPosixSpawn does.
+ */
+static pid_t spawnWithForkExec(char *argv[], int childIn, int childOut, int childErr) throw (SubprocessException) {
   pid_t pid = fork();
 
   if ( pid == -1 )
@@ -45,34 +71,307 @@ subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOut
   
   if ( pid == 0 )
   {
-    close(pipe_2[0]);
-    close(pipe_1[1]);
-
-    if (supplyChildInput)
-      dup2(pipe_1[0], STDIN_FILENO);
-    else
-      close(pipe_1[0]);
-    if (ingestChildOutput)
-      dup2(pipe_2[1], STDOUT_FILENO);
-    else
-      close(pipe_2[1]);
+    if (childIn != kNotInUse)
+      dup2(childIn, STDIN_FILENO);
+    if (childOut != kNotInUse)
+      dup2(childOut, STDOUT_FILENO);
+    if (childErr != kNotInUse)
+      dup2(childErr, STDERR_FILENO);
      
     execvp( argv[0], argv );
     throw SubprocessException("Execution passed execvp()");
   }
-  
-  sp.pid = pid;
-  close(pipe_1[0]);
-  close(pipe_2[1]);
-
-  if (ingestChildOutput)
-    sp.ingestfd = pipe_2[0];
-  else
-    close(pipe_2[0]);
-  if (supplyChildInput)
-    sp.supplyfd = pipe_1[1];
-  else
-    close(pipe_1[0]);
+
+  return pid;
+}
+
+/**
+ * Function: subprocess
+ * --------------------
+ * Creates a new process running the executable identified via argv[0].
+ *
+ *   argv: the NULL-terminated argument vector that should be passed to the new process's main function
+ *   supplyChildInput: true if the parent process would like to pipe content to the new process's stdin, false otherwise
+ *   ingestChildOutput: true if the parent would like the child's stdout to be pushed to the parent, false otheriwse
+ *   ingestChildErrors: true if the parent would like the child's stderr to be pushed to the parent, false otherwise
+ *   strategy: how the child process is created
+ *
+ * Only the pipes the caller asked for are created, and the parent closes the
+ * child's ends of them as soon as the child exists.
+ */
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput, bool ingestChildErrors,
+                        SpawnStrategy strategy) throw (SubprocessException) {
+  subprocess_t sp = {0, kNotInUse, kNotInUse, kNotInUse};
+  int supply[2] = {kNotInUse, kNotInUse};
+  int ingest[2] = {kNotInUse, kNotInUse};
+  int error[2] = {kNotInUse, kNotInUse};
+
+  if ( (supplyChildInput && pipe2(supply, O_CLOEXEC) == -1) ||
+       (ingestChildOutput && pipe2(ingest, O_CLOEXEC) == -1) ||
+       (ingestChildErrors && pipe2(error, O_CLOEXEC) == -1) ) {
+    for (int fd: {supply[0], supply[1], ingest[0], ingest[1], error[0], error[1]})
+      if (fd != kNotInUse) close(fd);
+    throw SubprocessException("Error with pipe2()");
+  }
+
+  try {
+    if (strategy == kForkExec)
+      sp.pid = spawnWithForkExec(argv, supply[0], ingest[1], error[1]);
+    else
+      sp.pid = spawnWithPosixSpawn(argv, supply[0], ingest[1], error[1]);
+  } catch (const SubprocessException& se) {
+    for (int fd: {supply[0], supply[1], ingest[0], ingest[1], error[0], error[1]})
+      if (fd != kNotInUse) close(fd);
+    throw;
+  }
+
+  if (supplyChildInput) {
+    close(supply[0]);
+    sp.supplyfd = supply[1];
+  }
+  if (ingestChildOutput) {
+    close(ingest[1]);
+    sp.ingestfd = ingest[0];
+  }
+  if (ingestChildErrors) {
+    close(error[1]);
+    sp.errorfd = error[0];
+  }
 
   return sp;
 }
+
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput,
+                        SpawnStrategy strategy) throw (SubprocessException) {
+  return subprocess(argv, supplyChildInput, ingestChildOutput, false, strategy);
+}
+
+static const size_t kTransferChunk = 1 << 16;
+
+/**
+ * Type: pump
+ * ----------
+ * Moves data in one direction between one of the child's pipes and the
+ * caller.  Either end can be memory instead of a descriptor: a src of
+ * kNotInUse means the data comes from input (starting at offset), and a dst
+ * of kNotInUse means it's appended to output (or dropped, if output is NULL).
+ *
+ * A pump always waits on exactly one descriptor.  Between two descriptors we
+ * can't tell which end made a nonblocking splice fail with EAGAIN, so the
+ * pump simply waits on the other end from the one it last waited on; if
+ * that guess is wrong, poll returns right away and the next EAGAIN flips it
+ * back.  When splice isn't possible (neither end is a pipe it can work with)
+ * the pump falls back to read and write through staged.
+ */
+struct pump {
+  int src;
+  int dst;
+  int *childfd;           // the field in the subprocess_t this pump drives
+  const string *input;
+  size_t offset;
+  string *output;
+  bool useSplice;
+  string staged;
+  int waitfd;
+  short waitEvents;
+  bool done;
+};
+
+static void waitOn(pump& p, int fd) {
+  p.waitfd = fd;
+  p.waitEvents = fd == p.src ? POLLIN : POLLOUT;
+}
+
+static void finishPump(pump& p) {
+  p.done = true;
+  close(*p.childfd);
+  *p.childfd = kNotInUse;
+}
+
+/**
+ * Function: handleWriteError
+ * --------------------------
+ * The child closing its stdin early just means it's done with its input.  If
+ * the caller's own sink goes away, the child's output is drained and dropped
+ * from then on so the child never blocks on a full pipe.
+ */
+static void handleWriteError(pump& p) throw (SubprocessException) {
+  if (errno != EPIPE) throw SubprocessException(string("Error writing to pipe: ") + strerror(errno));
+  if (p.dst == *p.childfd) {
+    finishPump(p);
+  } else {
+    p.dst = kNotInUse;
+    p.output = NULL;
+    p.useSplice = false;
+    waitOn(p, p.src);
+  }
+}
+
+/**
+ * Function: advance
+ * -----------------
+ * Moves as much data through p as it can without blocking, and leaves p
+ * waiting on whichever descriptor it needs next.
+ */
+static void advance(pump& p) throw (SubprocessException) {
+  char buffer[kTransferChunk];
+  while (!p.done) {
+    ssize_t n;
+    if (p.src == kNotInUse) {
+      if (p.offset == p.input->size()) {
+        finishPump(p);
+        return;
+      }
+      n = write(p.dst, p.input->data() + p.offset, p.input->size() - p.offset);
+      if (n > 0) {
+        p.offset += n;
+      } else if (errno == EAGAIN) {
+        waitOn(p, p.dst);
+        return;
+      } else if (errno != EINTR) {
+        handleWriteError(p);
+      }
+    } else if (p.dst == kNotInUse) {
+      n = read(p.src, buffer, sizeof(buffer));
+      if (n > 0) {
+        if (p.output != NULL) p.output->append(buffer, n);
+      } else if (n == 0) {
+        finishPump(p);
+      } else if (errno == EAGAIN) {
+        waitOn(p, p.src);
+        return;
+      } else if (errno != EINTR) {
+        throw SubprocessException(string("Error reading from pipe: ") + strerror(errno));
+      }
+    } else if (p.useSplice) {
+      n = splice(p.src, NULL, p.dst, NULL, kTransferChunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) continue;
+      if (n == 0) {
+        finishPump(p);
+      } else if (errno == EAGAIN) {
+        waitOn(p, p.waitfd == p.src ? p.dst : p.src);
+        return;
+      } else if (errno == EINVAL) {
+        p.useSplice = false;
+      } else if (errno != EINTR) {
+        handleWriteError(p);
+      }
+    } else if (!p.staged.empty()) {
+      n = write(p.dst, p.staged.data(), p.staged.size());
+      if (n > 0) {
+        // The caller's descriptor may be blocking, so only touch it once poll says so.
+        p.staged.erase(0, n);
+        waitOn(p, p.staged.empty() ? p.src : p.dst);
+        return;
+      } else if (errno == EAGAIN) {
+        waitOn(p, p.dst);
+        return;
+      } else if (errno != EINTR) {
+        handleWriteError(p);
+      }
+    } else {
+      n = read(p.src, buffer, sizeof(buffer));
+      if (n > 0) {
+        p.staged.assign(buffer, n);
+        waitOn(p, p.dst);
+        return;
+      } else if (n == 0) {
+        finishPump(p);
+      } else if (errno == EAGAIN) {
+        waitOn(p, p.src);
+        return;
+      } else if (errno != EINTR) {
+        throw SubprocessException(string("Error reading from descriptor: ") + strerror(errno));
+      }
+    }
+  }
+}
+
+static void addPump(vector<pump>& pumps, int src, int dst, int *childfd,
+                    const string *input, string *output, int pipeSize) {
+  if (pipeSize > 0) fcntl(*childfd, F_SETPIPE_SZ, pipeSize); // best effort
+  fcntl(*childfd, F_SETFL, fcntl(*childfd, F_GETFL) | O_NONBLOCK);
+  pump p = {src, dst, childfd, input, 0, output, src != kNotInUse && dst != kNotInUse, "", kNotInUse, 0, false};
+  waitOn(p, src != kNotInUse ? src : dst);
+  pumps.push_back(p);
+}
+
+/**
+ * Function: runPumps
+ * ------------------
+ * Polls every pump until all of them are done, then reaps the child.  SIGPIPE
+ * is blocked throughout, since a child that stops reading its input is an
+ * ordinary outcome here; any SIGPIPE raised along the way is discarded
+ * before the caller's signal mask is restored.
+ */
+static int runPumps(subprocess_t& sp, vector<pump>& pumps) throw (SubprocessException) {
+  sigset_t pipeMask, existingMask, pending;
+  sigemptyset(&pipeMask);
+  sigaddset(&pipeMask, SIGPIPE);
+  sigpending(&pending);
+  bool alreadyPending = sigismember(&pending, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeMask, &existingMask);
+
+  try {
+    vector<struct pollfd> fds;
+    vector<size_t> owners;
+    while (true) {
+      fds.clear();
+      owners.clear();
+      for (size_t i = 0; i < pumps.size(); i++) {
+        if (pumps[i].done) continue;
+        fds.push_back({pumps[i].waitfd, pumps[i].waitEvents, 0});
+        owners.push_back(i);
+      }
+      if (fds.empty()) break;
+      if (poll(fds.data(), fds.size(), -1) < 0) {
+        if (errno == EINTR) continue;
+        throw SubprocessException("Error with poll()");
+      }
+      for (size_t k = 0; k < fds.size(); k++)
+        if (fds[k].revents != 0) advance(pumps[owners[k]]);
+    }
+  } catch (const SubprocessException& se) {
+    for (pump& p: pumps)
+      if (!p.done) finishPump(p);
+    pthread_sigmask(SIG_SETMASK, &existingMask, NULL);
+    throw;
+  }
+
+  sigpending(&pending);
+  if (!alreadyPending && sigismember(&pending, SIGPIPE)) {
+    struct timespec immediately = {0, 0};
+    sigtimedwait(&pipeMask, NULL, &immediately);
+  }
+  pthread_sigmask(SIG_SETMASK, &existingMask, NULL);
+
+  int status;
+  while (waitpid(sp.pid, &status, 0) < 0)
+    if (errno != EINTR) throw SubprocessException("Error with waitpid()");
+  return status;
+}
+
+int communicate(subprocess_t& sp, const string& input, string& output, string& errors,
+                int pipeSize) throw (SubprocessException) {
+  vector<pump> pumps;
+  if (sp.supplyfd != kNotInUse)
+    addPump(pumps, kNotInUse, sp.supplyfd, &sp.supplyfd, &input, NULL, pipeSize);
+  if (sp.ingestfd != kNotInUse)
+    addPump(pumps, sp.ingestfd, kNotInUse, &sp.ingestfd, NULL, &output, pipeSize);
+  if (sp.errorfd != kNotInUse)
+    addPump(pumps, sp.errorfd, kNotInUse, &sp.errorfd, NULL, &errors, pipeSize);
+  return runPumps(sp, pumps);
+}
+
+int communicate(subprocess_t& sp, int inputfd, int outputfd, int errorfd,
+                int pipeSize) throw (SubprocessException) {
+  static const string kNoInput;
+  vector<pump> pumps;
+  if (sp.supplyfd != kNotInUse)
+    addPump(pumps, inputfd, sp.supplyfd, &sp.supplyfd, &kNoInput, NULL, pipeSize);
+  if (sp.ingestfd != kNotInUse)
+    addPump(pumps, sp.ingestfd, outputfd, &sp.ingestfd, NULL, NULL, pipeSize);
+  if (sp.errorfd != kNotInUse)
+    addPump(pumps, sp.errorfd, errorfd, &sp.errorfd, NULL, NULL, pipeSize);
+  return runPumps(sp, pumps);
+}
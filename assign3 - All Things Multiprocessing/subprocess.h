@@ -54,6 +54,7 @@ int main(int argc, char *argv[]) {
 #pragma once
 #include <unistd.h> // for pid_t
 #include <fcntl.h>
+#include <string>
 #include "subprocess-exception.h"
 
 /**
@@ -73,14 +74,31 @@ static const int kNotInUse = -1;
  *  pid: the id of the child process created by a call to subprocess
  *  supplyfd: the descriptor where one pipes text to the child's stdin (or kNotInUse if child hasn't rewired its stdin)
  *  ingestfd: the descriptor where the text a child pushes to stdout shows up (or kNotInUse if child hasn't rewired its stdout)
+ *  errorfd: the descriptor where the text a child pushes to stderr shows up (or kNotInUse if child hasn't rewired its stderr)
  *
  */
 struct subprocess_t {
   pid_t pid;
   int supplyfd;
   int ingestfd;
+  int errorfd;
 };
  
+/**
+ * Type: SpawnStrategy
+ * -------------------
+ * Identifies how subprocess brings the child process into being.
+ *
+ *  kPosixSpawn: posix_spawnp with file actions for the pipe wiring.  glibc implements this
+ *               with clone(CLONE_VM | CLONE_VFORK), so the parent's page tables are never
+ *               copied and spawn cost doesn't grow with the parent's memory footprint.
+ *  kForkExec: a full fork followed by dup2 and execvp in the child.
+ */
+enum SpawnStrategy {
+  kPosixSpawn,
+  kForkExec
+};
+
 /**
  * Function: subprocess
  * --------------------
@@ -89,5 +107,50 @@ struct subprocess_t {
  *   argv: the NULL-terminated argument vector that should be passed to the new process's main function
  *   supplyChildInput: true if the parent process would like to pipe content to the new process's stdin, false otherwise
  *   ingestChildOutput: true if the parent would like the child's stdout to be pushed to the parent, false otheriwse
+ *   strategy: how the child process is created (see SpawnStrategy above)
+ */
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput,
+                        SpawnStrategy strategy = kPosixSpawn) throw (SubprocessException);
+
+/**
+ * Function: subprocess
+ * --------------------
+ * Same as above, except the child's stderr can be pushed to the parent as well.
+ *
+ *   ingestChildErrors: true if the parent would like the child's stderr to be pushed to the parent
+ *                      through errorfd, false otherwise
+ */
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput, bool ingestChildErrors,
+                        SpawnStrategy strategy = kPosixSpawn) throw (SubprocessException);
+
+/**
+ * Function: communicate
+ * ---------------------
+ * Drives every pipe of sp at once until the child has consumed all of its input and
+ * closed its output, then waits for the child and returns its status (as reported by
+ * waitpid).  Since supply, ingest, and error are all serviced concurrently via poll, a
+ * child that produces lots of output before it's finished reading its input can't
+ * deadlock against the parent.  communicate closes every descriptor in sp and sets
+ * each to kNotInUse.
+ *
+ * This version moves data between sp and in-memory strings:
+ *
+ *   input: everything to be written to the child's stdin (ignored if sp.supplyfd isn't in use)
+ *   output: receives everything the child writes to stdout
+ *   errors: receives everything the child writes to stderr
+ *   pipeSize: if positive, the capacity sp's pipes are raised to via F_SETPIPE_SZ (best effort)
+ */
+int communicate(subprocess_t& sp, const std::string& input, std::string& output, std::string& errors,
+                int pipeSize = 0) throw (SubprocessException);
+
+/**
+ * Function: communicate
+ * ---------------------
+ * Same as above, except data moves between sp and descriptors.  Whenever the other
+ * end is a file or a pipe, data is moved with splice and never copied through user
+ * space.  Any of inputfd, outputfd, and errorfd may be kNotInUse: no input means the
+ * child's stdin is closed right away, and no sink means the corresponding output is
+ * drained and discarded.  The caller's descriptors are left open.
  */
-subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput) throw (SubprocessException);
+int communicate(subprocess_t& sp, int inputfd, int outputfd, int errorfd,
+                int pipeSize = 0) throw (SubprocessException);
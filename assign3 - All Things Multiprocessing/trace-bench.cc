@@ -0,0 +1,151 @@
+/**
+ * File: trace-bench.cc
+ * --------------------
+ * Measures what trace costs a workload.  Every trace-workload tracee is run
+ * natively and then under each of trace's modes, and the table reports the
+ * native run time along with how many times slower each traced run was.
+ * Every figure is the median of several runs, and all output (the tracee's
+ * and trace's) goes to /dev/null, so terminal speed doesn't figure in.
+ *
+ *    > ./trace-bench [runs] [workload ...]
+ *
+ * The filtered mode traces just openat and close, which only open-stat makes
+ * in its loop, so it shows both what a filter saves when the system calls of
+ * interest are rare and what it costs when they aren't.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace std;
+
+extern char **environ;
+
+static const size_t kDefaultRuns = 3;
+static const char *const kDefaultWorkloads[] = {"getpid", "small-rw", "large-rw", "open-stat", "storm"};
+static const string kWorkloadExecutable = "./trace-workload";
+static const string kTraceExecutable = "./trace";
+static const string kRecordFile = "/tmp/trace-bench.log";
+
+/**
+ * Type: mode
+ * ----------
+ * One way of running a workload: name heads its column, flags are what's passed
+ * to trace, and traced is false for the native run.
+ */
+struct mode {
+  const char *name;
+  vector<string> flags;
+  bool traced;
+};
+
+static const vector<mode> kModes = {
+  {"native (s)", {}, false},
+  {"--simple", {"--simple"}, true},
+  {"full", {}, true},
+  {"filtered", {"--filter=openat,close"}, true},
+  {"--record", {"--record=" + kRecordFile}, true},
+};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Function: timeRun
+ * -----------------
+ * Runs argv to completion with its standard output and error sent to /dev/null,
+ * and returns how many seconds that took, or -1 if it couldn't be run or failed.
+ */
+static double timeRun(const vector<string>& argv) {
+  vector<char *> args;
+  for (const string& arg: argv) args.push_back(const_cast<char *>(arg.c_str()));
+  args.push_back(NULL);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  double start = now();
+  pid_t pid;
+  int err = posix_spawn(&pid, args[0], &actions, NULL, args.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) return -1;
+  int status;
+  waitpid(pid, &status, 0);
+  double elapsed = now() - start;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? elapsed : -1;
+}
+
+/**
+ * Function: medianRun
+ * -------------------
+ * Returns the median of runs timed runs of argv, or -1 if any of them failed.
+ */
+static double medianRun(const vector<string>& argv, size_t runs) {
+  vector<double> times;
+  for (size_t i = 0; i < runs; i++) {
+    double elapsed = timeRun(argv);
+    if (elapsed < 0) return -1;
+    times.push_back(elapsed);
+  }
+  sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+  size_t runs = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultRuns;
+  if (runs == 0) {
+    cerr << "Usage: " << argv[0] << " [runs] [workload ...]" << endl;
+    return 1;
+  }
+  vector<string> workloads;
+  for (int i = 2; i < argc; i++) workloads.push_back(argv[i]);
+  if (workloads.empty()) workloads.assign(begin(kDefaultWorkloads), end(kDefaultWorkloads));
+
+  cout << setw(12) << "workload";
+  for (const mode& m: kModes) cout << setw(12) << m.name;
+  cout << endl << fixed;
+
+  int result = 0;
+  for (const string& workload: workloads) {
+    cout << setw(12) << workload << flush;
+    double native = 0;
+    for (const mode& m: kModes) {
+      vector<string> command;
+      if (m.traced) {
+        command.push_back(kTraceExecutable);
+        command.insert(command.end(), m.flags.begin(), m.flags.end());
+      }
+      command.push_back(kWorkloadExecutable);
+      command.push_back(workload);
+
+      double elapsed = medianRun(command, runs);
+      if (elapsed < 0 || (m.traced && native == 0)) {
+        cout << setw(12) << "failed" << flush;
+        result = 1;
+        continue;
+      }
+      if (!m.traced) {
+        native = elapsed;
+        cout << setw(12) << setprecision(3) << native << flush;
+      } else {
+        cout << setw(11) << setprecision(1) << elapsed / native << "x" << flush;
+      }
+    }
+    cout << endl;
+  }
+
+  unlink(kRecordFile.c_str());
+  return result;
+}
@@ -0,0 +1,116 @@
+/**
+ * File: trace-decode.cc
+ * ---------------------
+ * Prints a log written by trace --record exactly as trace would have printed
+ * it live, e.g.
+ *
+ *    > ./trace --record=ls.log ls /
+ *    > ./trace-decode ls.log
+ *
+ * trace-decode accepts the same --simple, --stats, and --filter=name,... flags
+ * trace does, and applies them to the log after the fact, so one recording
+ * can be examined several ways.  --stats computes its latencies from the
+ * timestamps in the log, so they include the time it took trace to capture
+ * each system call's arguments, but none of the time spent printing them.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "trace-options.h"
+#include "trace-error-constants.h"
+#include "trace-system-calls.h"
+#include "trace-stats.h"
+#include "trace-record.h"
+#include "trace-format.h"
+#include "trace-exception.h"
+using namespace std;
+
+/**
+ * Function: unpackStrings
+ * -----------------------
+ * Points strings[i] at the string logged for argument i, for every bit i set
+ * in r.stringMask.  The strings are packed one after another in argument order.
+ */
+static void unpackStrings(const traceRecord& r, const char *packed, const char *strings[]) {
+  for (size_t i = 0; i < systemCallTable::kMaxArguments; i++) {
+    strings[i] = NULL;
+    if ((r.stringMask & (1 << i)) == 0) continue;
+    strings[i] = packed;
+    packed += strlen(packed) + 1;
+  }
+}
+
+/**
+ * Function: decode
+ * ----------------
+ * Feeds every record in log that survives the filter to either the formatter
+ * or (in --stats mode) the statistics, pairing each exit with the entry that
+ * came before it on the same thread.
+ */
+static void decode(traceLogReader& log, const traceOptions& options, const set<int>& filter,
+                   traceFormatter& formatter, systemCallStats& stats) {
+  unordered_map<int32_t, uint64_t> entered;
+  const traceRecord *r;
+  const char *packed;
+  while (log.next(r, packed)) {
+    if (!filter.empty() && filter.find(r->syscall) == filter.end()) continue;
+    if (!options.stats) {
+      const char *strings[systemCallTable::kMaxArguments];
+      unpackStrings(*r, packed, strings);
+      formatter.render(*r, strings);
+    } else if (r->kind == traceRecord::kEntry) {
+      entered[r->tid] = r->timestamp;
+    } else if (r->kind == traceRecord::kExit) {
+      long retval = r->values[0];
+      stats.record(r->syscall, r->timestamp - entered[r->tid], retval < 0 && retval >= -4095);
+    } else {
+      stats.recordUnfinished(r->syscall);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  traceOptions options;
+  size_t numFlags;
+  try {
+    numFlags = processCommandLineFlags(options, argv);
+    if (!options.record.empty() || options.attach != 0)
+      throw TraceException(string(argv[0]) + ": --record, -p, and --sample only make sense for trace");
+  } catch (const TraceException& te) {
+    cerr << te.what() << endl;
+    return 1;
+  }
+  if (argc - numFlags != 2) {
+    cerr << "Usage: " << argv[0] << " [--simple] [--stats] [--filter=name,...] log" << endl;
+    return 1;
+  }
+
+  systemCallTable systemCalls;
+  map<int, string> errorStrings;
+  traceLogReader log;
+  set<int> filter;
+  try {
+    compileSystemCallErrorStrings(errorStrings);
+    systemCalls.load(options.rebuild);
+    for (const string& name: options.filter) {
+      int number = systemCalls.lookup(name);
+      if (number < 0) throw TraceException("Unknown system call in --filter: " + name);
+      filter.insert(number);
+    }
+    log.open(argv[numFlags + 1]);
+  } catch (const TraceException& te) {
+    cerr << te.what() << endl;
+    return 1;
+  }
+
+  traceFormatter formatter(cout, systemCalls, errorStrings, /* flushEntries = */ false);
+  formatter.setSimple(options.simple);
+  systemCallStats stats;
+  decode(log, options, filter, formatter, stats);
+  formatter.finish();
+  if (options.stats) stats.print(cout, systemCalls);
+  return 0;
+}
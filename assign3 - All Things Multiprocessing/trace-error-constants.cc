@@ -62,7 +62,7 @@ static const string kErrorConstantDefinePattern = "[^E]*(E\\S*)\\s+(\\d+).*";
  * is added to the supplied map.
  */
 static void processLine(map<int, string>& errorConstants, const string& line) {
-  regex re(kErrorConstantDefinePattern); // all constants we're interested in begin with E
+  static const regex re(kErrorConstantDefinePattern); // all constants we're interested in begin with E; compiled once, not once per line
   smatch sm;
   if (!regex_match(line, sm, re)) return;
   assert(sm.size() == 3);
@@ -0,0 +1,115 @@
+/**
+ * File: trace-format.cc
+ * ---------------------
+ * Presents the implementation of the traceFormatter class.
+ */
+
+#include "trace-format.h"
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+traceFormatter::traceFormatter(ostream& os, const systemCallTable& systemCalls,
+                               const map<int, string>& errorStrings, bool flushEntries) :
+  os(os), systemCalls(systemCalls), errorStrings(errorStrings), flushEntries(flushEntries),
+  simple(false), openLineTid(0) {}
+
+/**
+ * Begins a new output line for tid.  If another thread's line is still waiting on
+ * its return value, that line is marked unfinished and closed first.  Returns true
+ * if tid's own line was still open (so the caller can just continue it).
+ */
+bool traceFormatter::startLine(pid_t tid) {
+  if (openLineTid == tid) return true;
+  if (openLineTid != 0) os << "<unfinished ...>" << endl;
+  os << "[pid " << dec << tid << "] ";
+  openLineTid = tid;
+  return false;
+}
+
+/**
+ * Positions the output so a return value for r's system call can be printed:
+ * either right after its arguments, or on a new "resumed" line if other output
+ * got in the way.
+ */
+void traceFormatter::resumeLine(const traceRecord& r) {
+  if (startLine(r.tid)) return;
+  if (simple)
+    os << "<... syscall(" << r.syscall << ") resumed> = ";
+  else
+    os << "<... " << systemCalls.getName(r.syscall) << " resumed> = ";
+}
+
+void traceFormatter::printArguments(const traceRecord& r, const char *const strings[]) {
+  const systemCallTable::entry& signature = systemCalls.getEntry(r.syscall);
+  int n = signature.numArguments;
+  for (int i = 0; i < n; i++) {
+    long val = r.values[i];
+    switch ((scParamType) signature.types[i]) {
+      case SYSCALL_INTEGER:
+        os << dec << (int) val;
+        break;
+      case SYSCALL_STRING:
+        os << '"' << ((r.stringMask & (1 << i)) ? strings[i] : "") << '"';
+        break;
+      case SYSCALL_POINTER:
+        if (val != 0)
+          os << "0x" << hex << val;
+        else
+          os << "NULL";
+        break;
+      case SYSCALL_UNKNOWN_TYPE:
+        os << "<UNKOWN SIGNATURE>";
+        break;
+    }
+    os << (i == n - 1 ? "" : ", ");
+  }
+}
+
+void traceFormatter::printReturnValue(long retval, bool address) {
+  if (retval >= 0) {
+    if (address)
+      os << "0x" << hex << retval;
+    else
+      os << dec << (int) retval;
+  } else {
+    map<int, string>::const_iterator found = errorStrings.find(labs(retval));
+    os << "-1 " << (found == errorStrings.cend() ? "" : found->second) << " (" << strerror(labs(retval)) << ")";
+  }
+}
+
+void traceFormatter::render(const traceRecord& r, const char *const strings[]) {
+  switch (r.kind) {
+    case traceRecord::kEntry:
+      startLine(r.tid);
+      if (simple) {
+        os << "syscall(" << r.syscall << ") = ";
+      } else {
+        os << systemCalls.getName(r.syscall) << "(";
+        printArguments(r, strings);
+        os << ") = ";
+      }
+      if (flushEntries) os << flush;
+      return;
+    case traceRecord::kExit:
+      resumeLine(r);
+      if (simple)
+        os << (long) r.values[0] << endl;
+      else {
+        printReturnValue(r.values[0], systemCalls.getEntry(r.syscall).returnsAddress);
+        os << endl;
+      }
+      openLineTid = 0;
+      return;
+    case traceRecord::kNoReturn:
+      resumeLine(r);
+      os << "<no return>" << endl;
+      openLineTid = 0;
+      return;
+  }
+}
+
+void traceFormatter::finish() {
+  if (openLineTid != 0) os << "<unfinished ...>" << endl;
+  openLineTid = 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * File: trace-format.h
+ * --------------------
+ * Exports the traceFormatter class, which renders traceRecords as the lines
+ * trace prints, e.g.
+ *
+ *    [pid 1234] openat(-100, "/etc/ld.so.cache", 524288, 0) = 3
+ *
+ * trace renders each record as it's captured, and trace-decode renders the
+ * records in a log written by trace --record, so both print exactly the same
+ * thing.
+ */
+
+#pragma once
+#include <map>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+#include "trace-record.h"
+#include "trace-system-calls.h"
+
+class traceFormatter {
+ public:
+/**
+ * Constructor: traceFormatter
+ * ---------------------------
+ * Renders onto os, naming system calls and errors with the supplied tables, which
+ * must outlive the formatter.  If flushEntries is true, os is flushed after every
+ * system call entry, so the line shows up before anything the system call prints.
+ */
+  traceFormatter(std::ostream& os, const systemCallTable& systemCalls,
+                 const std::map<int, std::string>& errorStrings, bool flushEntries);
+
+/**
+ * Method: setSimple
+ * -----------------
+ * If simple is true, system calls are printed by number, without arguments,
+ * and return values are printed as plain numbers (see trace --simple).
+ */
+  void setSimple(bool simple) { this->simple = simple; }
+
+/**
+ * Method: render
+ * --------------
+ * Prints r.  A kEntry record starts a line, and the matching kExit or kNoReturn
+ * record finishes it, unless some other thread's record came in between, in
+ * which case the first line is marked <unfinished ...> and the second begins
+ * with <... name resumed>.  strings[i] must be the string captured for argument
+ * i whenever bit i of r.stringMask is set.
+ */
+  void render(const traceRecord& r, const char *const strings[]);
+
+/**
+ * Method: finish
+ * --------------
+ * Closes the line still waiting on a return value, if there is one.
+ */
+  void finish();
+
+ private:
+  std::ostream& os;
+  const systemCallTable& systemCalls;
+  const std::map<int, std::string>& errorStrings;
+  bool flushEntries;
+  bool simple;
+  pid_t openLineTid; // the thread whose line is waiting on a return value, or 0
+
+  bool startLine(pid_t tid);
+  void resumeLine(const traceRecord& r);
+  void printArguments(const traceRecord& r, const char *const strings[]);
+  void printReturnValue(long retval, bool address);
+
+  traceFormatter(const traceFormatter& original) = delete;
+  traceFormatter& operator=(const traceFormatter& rhs) = delete;
+};
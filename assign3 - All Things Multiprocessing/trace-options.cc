@@ -11,14 +11,78 @@ using namespace std;
 
 static const string kSimpleFlag = "--simple";
 static const string kRebuildFlag = "--rebuild";
-size_t processCommandLineFlags(bool& simple, bool& rebuild, char *argv[]) throw (TraceException) {  
+static const string kFilterFlag = "--filter=";
+static const string kStatsFlag = "--stats";
+static const string kRecordFlag = "--record=";
+static const string kAttachFlag = "-p";
+static const string kSampleFlag = "--sample=";
+
+static vector<string> splitNames(const string& list) {
+  vector<string> names;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == string::npos) end = list.size();
+    string name = list.substr(start, end - start);
+    if (!name.empty()) names.push_back(name);
+    start = end + 1;
+  }
+  return names;
+}
+
+size_t processCommandLineFlags(traceOptions& options, char *argv[]) throw (TraceException) {  
+  options.simple = options.rebuild = options.stats = false;
+  options.filter.clear();
+  options.record.clear();
+  options.attach = 0;
+  options.sampleMillis = 0;
+  options.sampleSeconds = 0;
   size_t numFlags = 0;
-  for (int i = 1; argv[i] != NULL && startsWith(argv[i], "--"); i++) {
-    if (argv[i] == kSimpleFlag) simple = true;
-    else if (argv[i] == kRebuildFlag) rebuild = true;
+  for (int i = 1; argv[i] != NULL && (startsWith(argv[i], "--") || argv[i] == kAttachFlag); i++) {
+    if (argv[i] == kSimpleFlag) options.simple = true;
+    else if (argv[i] == kAttachFlag) {
+      size_t end = 0;
+      int pid = 0;
+      try {
+        if (argv[i + 1] != NULL) pid = stoi(argv[i + 1], &end);
+      } catch (const exception& e) {}
+      if (pid <= 0 || argv[i + 1][end] != '\0')
+        throw TraceException(string(argv[0]) + ": -p needs a process id");
+      options.attach = pid;
+      i++;
+      numFlags++;
+    }
+    else if (startsWith(argv[i], kSampleFlag)) {
+      vector<string> fields = splitNames(string(argv[i]).substr(kSampleFlag.size()));
+      try {
+        if (fields.size() == 2) {
+          options.sampleMillis = stoul(fields[0]);
+          options.sampleSeconds = stod(fields[1]);
+        }
+      } catch (const exception& e) {}
+      if (options.sampleMillis == 0 || options.sampleSeconds * 1000 < options.sampleMillis)
+        throw TraceException(string(argv[0]) + ": --sample needs a window in milliseconds no longer than its period in seconds (" + argv[i] + " )");
+    }
+    else if (argv[i] == kRebuildFlag) options.rebuild = true;
+    else if (argv[i] == kStatsFlag) options.stats = true;
+    else if (startsWith(argv[i], kFilterFlag)) {
+      options.filter = splitNames(string(argv[i]).substr(kFilterFlag.size()));
+      if (options.filter.empty())
+        throw TraceException(string(argv[0]) + ": No system calls listed (" + argv[i] + " )");
+    }
+    else if (startsWith(argv[i], kRecordFlag)) {
+      options.record = string(argv[i]).substr(kRecordFlag.size());
+      if (options.record.empty())
+        throw TraceException(string(argv[0]) + ": No log file named (" + argv[i] + " )");
+    }
     else throw TraceException(string(argv[0]) + ": Unrecognized flag (" + argv[i] + " )");
     numFlags++;
   }
+
+  if (options.sampleMillis > 0 && options.attach == 0)
+    throw TraceException(string(argv[0]) + ": --sample only works with -p");
+  if (options.attach != 0 && !options.filter.empty())
+    throw TraceException(string(argv[0]) + ": --filter only works for programs trace launches itself");
   
   return numFlags;
 }
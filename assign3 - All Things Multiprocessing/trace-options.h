@@ -4,15 +4,62 @@
  * Exports a single function that knows how to process the command line invoking
  * trace.  The command line typically looks like the invocation of another executable, e.g.
  * something like "find /usr/include/ -name *.h -print" preceded by "trace", e.g. 
- * "trace find /usr/include/ -name *.h -print".  However, trace itself can be fed one or two
- * flags, --simple and/or --rebuild.  The first one coaches trace to output a very simplified
- * version of trace, whereas the second one instructs trace to rebuild all of the prototypes
- * from scratch instead of relying on a cached file.
+ * "trace find /usr/include/ -name *.h -print".  However, trace itself can be fed a few
+ * flags first:
+ *
+ *   --simple: coaches trace to output a very simplified version of trace
+ *   --rebuild: instructs trace to rebuild all of the prototypes from scratch instead of
+ *              relying on a cached file
+ *   --filter=open,read,...: traces only the named system calls, letting every other one run
+ *                           at full speed
+ *   --stats: prints nothing while the program runs, and then a table of per-system-call
+ *            counts, errors, and latencies once it exits
+ *   --record=file: prints nothing while the program runs, and instead logs every system call
+ *                  to file in a compact binary format that trace-decode knows how to print
+ *   -p pid: attaches to the already running process pid (and all of its threads) instead of
+ *           launching a program; Ctrl-C detaches and leaves the process running
+ *   --sample=ms,seconds: with -p, attaches for ms milliseconds every seconds seconds until
+ *                        Ctrl-C (or until the process exits), and then prints --stats style
+ *                        counts and latencies aggregated over every window
  *
  * If the command line is malformed (e.g. bogus flags, etc), then a TraceException is thrown.
  */
 
 #pragma once
+#include <string>
+#include <vector>
+#include <sys/types.h>
 #include "trace-exception.h"
 
-size_t processCommandLineFlags(bool& simple, bool& rebuild, char *argv[]) throw (TraceException);
+/**
+ * Type: traceOptions
+ * ------------------
+ * Bundles everything the flags preceding the traced command line can configure.
+ *
+ *  simple: true if --simple was supplied
+ *  rebuild: true if --rebuild was supplied
+ *  filter: the system call names listed by --filter, or empty if every system call is traced
+ *  stats: true if --stats was supplied
+ *  record: the file named by --record, or empty if events are printed as they happen
+ *  attach: the pid supplied with -p, or 0 if trace launches the program itself
+ *  sampleMillis, sampleSeconds: the window length and period supplied with --sample,
+ *                               or 0 if the process is traced continuously
+ */
+struct traceOptions {
+  bool simple;
+  bool rebuild;
+  bool stats;
+  std::vector<std::string> filter;
+  std::string record;
+  pid_t attach;
+  unsigned int sampleMillis;
+  double sampleSeconds;
+};
+
+/**
+ * Function: processCommandLineFlags
+ * ---------------------------------
+ * Populates options from the flags at the front of argv (just after argv[0]) and
+ * returns how many there were.
+ */
+size_t processCommandLineFlags(traceOptions& options, char *argv[]) throw (TraceException);
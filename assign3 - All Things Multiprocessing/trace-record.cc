@@ -0,0 +1,154 @@
+/**
+ * File: trace-record.cc
+ * ---------------------
+ * Presents the implementation of the traceRecorder and traceLogReader classes.
+ */
+
+#include "trace-record.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+using namespace std;
+
+static const char kLogMagic[8] = {'t', 'r', 'a', 'c', 'e', 'l', 'o', 'g'};
+static const uint32_t kLogVersion = 1;
+static const size_t kRecordsPerChunk = 1 << 14;  // a little over 1MB of records
+static const size_t kStringsPerChunk = 1 << 20;
+
+static bool writeAll(int fd, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t n = writev(fd, iov, iovcnt);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+}
+
+traceRecorder::traceRecorder() : fd(-1) {}
+
+traceRecorder::~traceRecorder() {
+  try {
+    close();
+  } catch (const TraceException& te) {} // too late to report it
+}
+
+void traceRecorder::open(const string& filename) throw (TraceException) {
+  close();
+  fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) throw TraceException("Couldn't create " + filename + ": " + strerror(errno));
+  this->filename = filename;
+  records.reserve(kRecordsPerChunk);
+  strings.reserve(kStringsPerChunk);
+
+  traceLogHeader header;
+  memcpy(header.magic, kLogMagic, sizeof(kLogMagic));
+  header.version = kLogVersion;
+  header.recordSize = sizeof(traceRecord);
+  struct iovec iov = {&header, sizeof(header)};
+  if (!writeAll(fd, &iov, 1)) throw TraceException("Couldn't write to " + filename + ": " + strerror(errno));
+}
+
+void traceRecorder::record(traceRecord r, const string args[]) {
+  size_t stringsSize = 0;
+  for (size_t i = 0; i < systemCallTable::kMaxArguments; i++)
+    if (r.stringMask & (1 << i)) stringsSize += args[i].size() + 1;
+  if (records.size() == kRecordsPerChunk || strings.size() + stringsSize > kStringsPerChunk) flush();
+
+  r.stringsOffset = strings.size();
+  for (size_t i = 0; i < systemCallTable::kMaxArguments; i++) {
+    if ((r.stringMask & (1 << i)) == 0) continue;
+    strings.append(args[i]);
+    strings += '\0';
+  }
+  records.push_back(r);
+}
+
+void traceRecorder::flush() {
+  if (fd == -1 || records.empty()) return;
+  strings.resize((strings.size() + 7) & ~7, '\0'); // keeps the next chunk's records aligned
+  traceChunkHeader header = {(uint32_t) records.size(), (uint32_t) strings.size()};
+  struct iovec iov[] = {
+    {&header, sizeof(header)},
+    {records.data(), records.size() * sizeof(traceRecord)},
+    {const_cast<char *>(strings.data()), strings.size()}
+  };
+  if (error.empty() && !writeAll(fd, iov, sizeof(iov)/sizeof(iov[0])))
+    error = "Couldn't write to " + filename + ": " + strerror(errno);
+  records.clear();
+  strings.clear();
+}
+
+void traceRecorder::close() throw (TraceException) {
+  if (fd == -1) return;
+  flush();
+  if (::close(fd) < 0 && error.empty()) error = "Couldn't write to " + filename + ": " + strerror(errno);
+  fd = -1;
+  if (error.empty()) return;
+  string message = error;
+  error.clear();
+  throw TraceException(message);
+}
+
+traceLogReader::traceLogReader() : base(NULL), size(0), chunkOffset(0), recordInChunk(0) {}
+
+traceLogReader::~traceLogReader() {
+  if (base != NULL) munmap(const_cast<char *>(base), size);
+}
+
+void traceLogReader::open(const string& filename) throw (TraceException) {
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw TraceException("Couldn't open " + filename + ": " + strerror(errno));
+  struct stat info;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(traceLogHeader))
+    mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) throw TraceException(filename + " isn't a trace log.");
+
+  const traceLogHeader *header = static_cast<const traceLogHeader *>(mapping);
+  if (memcmp(header->magic, kLogMagic, sizeof(kLogMagic)) != 0 || header->version != kLogVersion ||
+      header->recordSize != sizeof(traceRecord)) {
+    munmap(mapping, info.st_size);
+    throw TraceException(filename + " isn't a trace log (or was written by a different version of trace).");
+  }
+
+  if (base != NULL) munmap(const_cast<char *>(base), size);
+  base = static_cast<const char *>(mapping);
+  size = info.st_size;
+  chunkOffset = sizeof(traceLogHeader);
+  recordInChunk = 0;
+}
+
+bool traceLogReader::next(const traceRecord *& record, const char *& strings) {
+  while (base != NULL && chunkOffset + sizeof(traceChunkHeader) <= size) {
+    const traceChunkHeader *chunk = reinterpret_cast<const traceChunkHeader *>(base + chunkOffset);
+    size_t recordsOffset = chunkOffset + sizeof(traceChunkHeader);
+    size_t stringsOffset = recordsOffset + (size_t) chunk->numRecords * sizeof(traceRecord);
+    if (stringsOffset + chunk->stringsSize > size) return false;
+    if (chunk->stringsSize > 0 && base[stringsOffset + chunk->stringsSize - 1] != '\0') return false;
+    if (recordInChunk == chunk->numRecords) {
+      chunkOffset = stringsOffset + chunk->stringsSize;
+      recordInChunk = 0;
+      continue;
+    }
+
+    record = reinterpret_cast<const traceRecord *>(base + recordsOffset) + recordInChunk++;
+    if (record->stringMask != 0 && record->stringsOffset >= chunk->stringsSize) return false;
+    strings = base + stringsOffset + record->stringsOffset;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,141 @@
+/**
+ * File: trace-record.h
+ * --------------------
+ * Defines the binary event log trace writes in --record mode, along with the
+ * traceRecorder class that writes one and the traceLogReader class that reads
+ * one back (see trace-decode.cc).
+ *
+ * A log is a traceLogHeader followed by any number of chunks.  Each chunk is a
+ * traceChunkHeader, then numRecords fixed-size traceRecords, then stringsSize
+ * bytes of NUL-terminated strings the chunk's records refer to.  Keeping the
+ * strings off to the side keeps every record the same size, and lets the
+ * recorder gather a whole chunk in memory and write it with a single writev.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "trace-exception.h"
+#include "trace-system-calls.h"
+
+/**
+ * Type: traceRecord
+ * -----------------
+ * One event in the life of a system call.
+ *
+ *  timestamp: CLOCK_MONOTONIC nanoseconds at the stop that produced the record
+ *  values: the arguments (kEntry) or, in values[0], the return value (kExit)
+ *  tid: the thread that made the system call
+ *  syscall: the system call number
+ *  stringsOffset: where this record's strings start in its chunk's string area
+ *  kind: kEntry, kExit, or kNoReturn (the thread died inside the call)
+ *  stringMask: bit i is set if argument i was captured as a string; those
+ *              strings follow one another at stringsOffset in argument order
+ */
+struct traceRecord {
+  static const uint8_t kEntry = 0;
+  static const uint8_t kExit = 1;
+  static const uint8_t kNoReturn = 2;
+
+  uint64_t timestamp;
+  uint64_t values[systemCallTable::kMaxArguments];
+  int32_t tid;
+  int32_t syscall;
+  uint32_t stringsOffset;
+  uint8_t kind;
+  uint8_t stringMask;
+  uint8_t reserved[2];
+};
+
+struct traceLogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+};
+
+struct traceChunkHeader {
+  uint32_t numRecords;
+  uint32_t stringsSize;
+};
+
+class traceRecorder {
+ public:
+  traceRecorder();
+  ~traceRecorder();
+
+/**
+ * Method: open
+ * ------------
+ * Creates (or truncates) the named log and writes its header.  The file is
+ * opened close-on-exec, so the tracee never inherits it.  Throws a
+ * TraceException if the file can't be created.
+ */
+  void open(const std::string& filename) throw (TraceException);
+  bool isOpen() const { return fd != -1; }
+
+/**
+ * Method: record
+ * --------------
+ * Appends r (and the strings for the arguments named by its stringMask, which
+ * are copied) to the current chunk, writing the chunk out first if there's no
+ * room left in it.  r.stringsOffset is filled in here.
+ */
+  void record(traceRecord r, const std::string strings[] = NULL);
+
+/**
+ * Methods: flush, close
+ * ---------------------
+ * flush writes out the current chunk, if it holds anything.  close flushes and
+ * closes the log; the destructor calls it if need be.  If any write failed
+ * (say, because the disk filled up), nothing more is written after it, and
+ * close throws a TraceException describing the failure, since the log is
+ * incomplete.  (The destructor swallows it.)
+ */
+  void flush();
+  void close() throw (TraceException);
+
+ private:
+  int fd;
+  std::string filename;
+  std::string error; // describes the first failed write, or empty
+  std::vector<traceRecord> records;
+  std::string strings;
+
+  traceRecorder(const traceRecorder& original) = delete;
+  traceRecorder& operator=(const traceRecorder& rhs) = delete;
+};
+
+class traceLogReader {
+ public:
+  traceLogReader();
+  ~traceLogReader();
+
+/**
+ * Method: open
+ * ------------
+ * Maps the named log into memory.  Throws a TraceException if it can't be
+ * opened or isn't a trace log.
+ */
+  void open(const std::string& filename) throw (TraceException);
+
+/**
+ * Method: next
+ * ------------
+ * Advances to the next record, returning false once there are none left (or
+ * the log is cut off mid-chunk, as it is if trace itself was killed).  On
+ * success, strings points to the record's first string, if it has any.
+ */
+  bool next(const traceRecord *& record, const char *& strings);
+
+ private:
+  const char *base;
+  size_t size;
+  size_t chunkOffset;
+  uint32_t recordInChunk;
+
+  traceLogReader(const traceLogReader& original) = delete;
+  traceLogReader& operator=(const traceLogReader& rhs) = delete;
+};
@@ -0,0 +1,106 @@
+/**
+ * File: trace-stats.cc
+ * --------------------
+ * Presents the implementation of the systemCallStats class.
+ */
+
+#include "trace-stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <vector>
+using namespace std;
+
+static size_t bucketFor(uint64_t nanoseconds) {
+  return nanoseconds == 0 ? 0 : 64 - __builtin_clzll(nanoseconds);
+}
+
+systemCallStats::summary& systemCallStats::lookup(int syscall) {
+  map<int, summary>::iterator found = summaries.find(syscall);
+  if (found != summaries.end()) return found->second;
+  summary& s = summaries[syscall];
+  memset(&s, 0, sizeof(s));
+  s.minNanos = UINT64_MAX;
+  return s;
+}
+
+void systemCallStats::record(int syscall, uint64_t nanoseconds, bool failed) {
+  summary& s = lookup(syscall);
+  s.calls++;
+  s.timed++;
+  if (failed) s.errors++;
+  s.totalNanos += nanoseconds;
+  s.minNanos = min(s.minNanos, nanoseconds);
+  s.maxNanos = max(s.maxNanos, nanoseconds);
+  s.histogram[min(bucketFor(nanoseconds), kNumBuckets - 1)]++;
+}
+
+void systemCallStats::recordUnfinished(int syscall) {
+  lookup(syscall).calls++;
+}
+
+/**
+ * Walks the histogram to the bucket holding the requested nearest rank and
+ * assumes latencies are spread evenly across that bucket.  The estimate is
+ * kept within the bucket and then clamped to the observed minimum and maximum,
+ * which makes the extreme percentiles exact.
+ */
+uint64_t systemCallStats::percentile(const summary& s, double fraction) {
+  if (s.timed == 0) return 0;
+  size_t rank = max<size_t>(1, ceil(fraction * s.timed)); // 1-based
+  size_t seen = 0;
+  for (size_t b = 0; b < kNumBuckets; b++) {
+    if (s.histogram[b] == 0) continue;
+    if (seen + s.histogram[b] >= rank) {
+      uint64_t low = b == 0 ? 0 : uint64_t(1) << (b - 1);
+      uint64_t high = b == 0 ? 1 : 2 * low;
+      double offset = (high - low) * (rank - seen - 0.5) / s.histogram[b];
+      uint64_t estimate = min(high - 1, max(low, low + uint64_t(offset)));
+      return min(s.maxNanos, max(s.minNanos, estimate));
+    }
+    seen += s.histogram[b];
+  }
+  return s.maxNanos;
+}
+
+void systemCallStats::print(ostream& os, const systemCallTable& systemCalls) const {
+  vector<pair<int, const summary *>> rows;
+  uint64_t totalNanos = 0;
+  size_t totalCalls = 0, totalErrors = 0;
+  for (const pair<const int, summary>& entry: summaries) {
+    rows.push_back(make_pair(entry.first, &entry.second));
+    totalNanos += entry.second.totalNanos;
+    totalCalls += entry.second.calls;
+    totalErrors += entry.second.errors;
+  }
+  sort(rows.begin(), rows.end(), [](const pair<int, const summary *>& a, const pair<int, const summary *>& b) {
+    return a.second->totalNanos > b.second->totalNanos;
+  });
+
+  ios::fmtflags flags = os.flags();
+  streamsize precision = os.precision();
+  os << fixed << setprecision(2);
+  os << setw(7) << "% time" << setw(12) << "seconds" << setw(11) << "usecs/call"
+     << setw(9) << "calls" << setw(8) << "errors" << setw(10) << "min(us)" << setw(10) << "p50(us)"
+     << setw(10) << "p90(us)" << setw(10) << "p99(us)" << setw(11) << "max(us)" << "  syscall" << endl;
+  os << string(108, '-') << endl;
+  for (const pair<int, const summary *>& row: rows) {
+    const summary& s = *row.second;
+    string name = systemCalls.getName(row.first);
+    if (name.empty()) name = "syscall_" + to_string(row.first);
+    os << setw(7) << (totalNanos == 0 ? 0.0 : 100.0 * s.totalNanos / totalNanos)
+       << setw(12) << setprecision(6) << s.totalNanos / 1e9 << setprecision(2)
+       << setw(11) << (s.timed == 0 ? 0.0 : s.totalNanos / 1e3 / s.timed)
+       << setw(9) << s.calls << setw(8) << s.errors
+       << setw(10) << (s.timed == 0 ? 0.0 : s.minNanos / 1e3)
+       << setw(10) << percentile(s, 0.5) / 1e3 << setw(10) << percentile(s, 0.9) / 1e3
+       << setw(10) << percentile(s, 0.99) / 1e3 << setw(11) << s.maxNanos / 1e3
+       << "  " << name << endl;
+  }
+  os << string(108, '-') << endl;
+  os << setw(7) << 100.0 << setw(12) << setprecision(6) << totalNanos / 1e9 << setw(11) << ""
+     << setw(9) << totalCalls << setw(8) << totalErrors << setw(50) << "" << "  total" << endl;
+  os.flags(flags);
+  os.precision(precision);
+}
@@ -0,0 +1,67 @@
+/**
+ * File: trace-stats.h
+ * -------------------
+ * Exports the systemCallStats class, which accumulates per-system-call counts,
+ * error counts, and latencies for trace's --stats mode, and prints them as a
+ * table (much like strace -c) once the tracee is gone.
+ *
+ * Every latency lands in a histogram with one bucket per power of two
+ * nanoseconds, so percentiles come out of a fixed 64 counters per system call
+ * no matter how many calls are recorded.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include "trace-system-calls.h"
+
+class systemCallStats {
+ public:
+/**
+ * Method: record
+ * --------------
+ * Records one completed call of the given system call, which took the supplied
+ * number of nanoseconds between its entry and exit stops.  failed should be true
+ * if the call returned an error.
+ */
+  void record(int syscall, uint64_t nanoseconds, bool failed);
+
+/**
+ * Method: recordUnfinished
+ * ------------------------
+ * Counts a call that never returned (exit_group, say) without timing it.
+ */
+  void recordUnfinished(int syscall);
+
+/**
+ * Method: print
+ * -------------
+ * Prints one row per system call, sorted by total time (largest first), with
+ * call and error counts, total and average time, and the minimum, median,
+ * 90th and 99th percentile, and maximum latency.  Percentiles are interpolated
+ * within their histogram bucket, so they're accurate to within a factor of two
+ * at worst and usually much better.
+ */
+  void print(std::ostream& os, const systemCallTable& systemCalls) const;
+
+ private:
+  static const size_t kNumBuckets = 64;
+
+  struct summary {
+    size_t calls;
+    size_t timed;
+    size_t errors;
+    uint64_t totalNanos;
+    uint64_t minNanos;
+    uint64_t maxNanos;
+    uint64_t histogram[kNumBuckets]; // bucket b holds latencies in [2^(b-1), 2^b)
+  };
+
+  std::map<int, summary> summaries;
+
+  summary& lookup(int syscall);
+  static uint64_t percentile(const summary& s, double fraction);
+};
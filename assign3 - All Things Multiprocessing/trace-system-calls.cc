@@ -8,10 +8,19 @@
 #include "trace-system-calls.h"
 #include <iostream>
 #include <fstream>
-#include <regex>
-#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <thread>
 #include <ext/stdio_filebuf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include "subprocess.h"
 #include "string-utils.h"
 #include "trace-exception.h"
@@ -63,107 +72,61 @@ istream& operator>>(istream& is, scParamType& type) {
 static const string kUniversalStandardAbsoluteFilename = "/usr/include/x86_64-linux-gnu/asm/unistd_64.h";
 
 /**
- * Constant: kSystemCallNumberDefinePattern
- * ----------------------------------------
- * Provides the regex pattern we use to identify those lines within kUniversalStandardAbsoluteFilename with
- * name -> number mappings for system calls.  The lines of interest all look like this:
- * 
- *   #define __NR_read 0
- *   #define __NR_write 1
- *   #define __NR_open 2
- *   #define __NR_close 3
- *   #define __NR_stat 4
- *
- * The regex pattern defined below is designed to match these five lives and all of the others structured just like it.
- * Breakdown on why we use [^_]+__NR_(\\w+)\\s+(\\d+)\\s*
- *    
- *     [^_]+ matches everything up through the very first underscore
- *     __NR_ matches precisely that: __NR_
- *     (\\w+) matches the cluster of letters, numbers, and underscores following __NR_.  This cluster is
- *            the name of the system call (e.g. read, fork, waitpid, stat), and that's why we wrap it in
- *            parentheses--so it can be surfaced via sm[1] for the smatch called sm.
- *     \\s+ matches all of the whitespace following the __NR_<system call name>
- *     (\\d+) matches the number that the system call name maps to.  It's also wrapped in parentheses so
- *            that we can surface the integer via sm[2] for the match called sm.
- *     \\s* matches all of the remaining whitespace following the number
- *
- * The full regex, therefore, matches lines like:
- *
- *   #define __NR_read 0
- *   #define __NR_write 1
- *   #define __NR_open 2
- *   #define __NR_close 3
- *   #define __NR_stat 4
- *
- * It does not, however, match lines like this:
- *
- *   #define _NR__read 0
- *   #define __NR_read 14x
- *   #define __NR_read 14 fjkdjkd
- *
+ * Function: skipSpaces
+ * --------------------
+ * Returns the first position at or after pos within [pos, end) that isn't whitespace.
  */
-static const string kSystemCallNumberDefinePattern = "[^_]+__NR_(\\w+)\\s+(\\d+)\\s*";
+static const char *skipSpaces(const char *pos, const char *end) {
+  while (pos < end && isspace(static_cast<unsigned char>(*pos))) pos++;
+  return pos;
+}
+
+static bool isIdentifierChar(char ch) {
+  return isalnum(static_cast<unsigned char>(ch)) || ch == '_';
+}
 
 /**
  * Function: collectSystemCallNumbers
  * ----------------------------------
- * Reads through kUniversalStandardAbsoluteFilename line by line, ignorning those that don't match
- * kSystemCallNumberDefinePattern, ands add a new number -> name and name -> number association to 
- * systemCallNumbers and systemCallNames for each line that does.
+ * Reads through kUniversalStandardAbsoluteFilename line by line and adds a new number -> name and
+ * name -> number association to systemCallNumbers and systemCallNames for every line that looks
+ * like this:
+ *
+ *   #define __NR_read 0
+ *
+ * i.e. anything up through __NR_, the system call name, whitespace, the number, and nothing but
+ * whitespace after that.  Lines like "#define __NR_read 14x" or "#define __NR_read 14 fjkdjkd"
+ * are ignored.
  */
 static void collectSystemCallNumbers(map<int, string>& systemCallNumbers, map<string, int>& systemCallNames) {
   ifstream infile(kUniversalStandardAbsoluteFilename);
   if (infile.fail()) 
     throw MissingFileException("Encountered a problem opening \"" + kUniversalStandardAbsoluteFilename);
 
-  regex re(kSystemCallNumberDefinePattern);
+  static const string kPrefix = "__NR_";
   string line;
   while (true) {
     getline(infile, line);
     if (infile.fail()) break;
-    smatch sm;
-    if (!regex_match(line, sm, re)) continue;
-    const string& name = sm[1];
-    int number = stoi(sm[2]); // stoi converts a digit string to an int
+    size_t found = line.find(kPrefix);
+    if (found == string::npos || found == 0 || line.find('_') < found) continue;
+
+    const char *pos = line.data() + found + kPrefix.size(), *end = line.data() + line.size();
+    const char *nameStart = pos;
+    while (pos < end && isIdentifierChar(*pos)) pos++;
+    const char *nameEnd = pos;
+    pos = skipSpaces(pos, end);
+    if (nameStart == nameEnd || pos == nameEnd || pos == end || !isdigit(static_cast<unsigned char>(*pos))) continue;
+    int number = 0;
+    while (pos < end && isdigit(static_cast<unsigned char>(*pos))) number = 10 * number + (*pos++ - '0');
+    if (skipSpaces(pos, end) != end) continue;
+
+    string name(nameStart, nameEnd);
     systemCallNumbers[number] = name;
     systemCallNames[name] = number;
   }
 }
 
-/**
- * Constant: kSystemCallNameAndSignaturePattern
- * --------------------------------------------
- * Defines the pattern used to recognize the argument count and system call name of a string already confirmed
- * to be a SYSCALL_DEFINE macro call.
- *
- * This is the regex pattern of interest:
- *
- *    \\s*SYSCALL_DEFINE([0-6])\\(([^,)]+)([^)]+)*\\)\\s*
- *
- *  Here's the breakdown of what it matches and why:
- *
- *    \\s* matches any leading whitespace
- *    SYSCALL_DEFINE matches precisely that: SYSCALL_DEFINE
- *    ([0-6]) matches a single digit string between 0 and 6, inclusive.  It's wrapped in parentheses
- *            so that the number string can be surfaced via sm[1] of an smatch called sm.
- *    \\s* matches any whitespace between the argument count and the opening parenthesis
- *    \\( matches exactly that: a single open parenthesis (the \\ is needed because '(' is a metacharacter)
- *    ([^,)]+) matches everything up beyond the macro's opening parenthesis up through either the first comma or the closing parenthesis,
- *             whichever comes first.  This is wrapped in parentheses so that whatever matches it can be surfaced via sm[2] and taken
- *             to be the name of a system call.  (There may be some extra whitespace around the system call name, but that gets trimmed elsewhere)
- *    .* matches everything after the , or ) that marks the end of the system call name.
- */
-static const string kSystemCallNameAndSignaturePattern = "\\s*SYSCALL_DEFINE([0-6])\\s*\\(([^,)]+).*";
-static pair<string, int> processNameAndArgumentCount(const string& macro, map<string, systemCallSignature>& systemCallSignatures) {
-  regex re(kSystemCallNameAndSignaturePattern);
-  smatch sm;
-  assert(regex_match(macro, sm, re));
-  assert(sm.size() == 3);
-  const string& name = sm[2];
-  int numArguments = stoi(sm[1]);
-  return make_pair(name, numArguments);
-}
-
 /**
  * Function: normalizeType
  * -----------------------
@@ -177,71 +140,30 @@ static scParamType normalizeType(const string& type) {
 }
 
 /**
- * Function: processSystemCallArguments
- * ------------------------------------
- * Processes the argument list portion of a SYSCALL_DEFINE macro.  The regex pattern is dynamically generated to
- * match the number of additional macro arguments expected.
- *
- * TODO: // simplify this to a static regex pattern that works for all argument counts.
+ * Function: normalizeSpaces
+ * -------------------------
+ * Returns [start, end) with leading and trailing whitespace removed and every internal run
+ * of whitespace (including the line breaks of a macro that spans several lines) collapsed
+ * to a single space.
  */
-static void processSystemCallArguments(const string& macro, int numArguments, systemCallSignature& parameterTypes) {
-  assert(numArguments > 0);
-  string pattern = "[^(]+\\([^,]+"; // skip everything up through and including macro name, open parenthesis, and first token
-  for (int i = 0; i < 2 * numArguments; i++) pattern += ",([^,]+)";
-  pattern += "\\s*\\)\\s*";
-  regex re(pattern);
-  smatch sm;
-  assert(regex_match(macro, sm, re));
-  assert(int(sm.size()) == (2 * numArguments + 1));
-  for (int i = 0; i < numArguments; i++) {
-    string type = sm[2 * i + 1];
-    scParamType normalizedType = normalizeType(trim(type));
-    parameterTypes.push_back(normalizedType);
+static string normalizeSpaces(const char *start, const char *end) {
+  string result;
+  for (const char *pos = skipSpaces(start, end); pos < end; pos++) {
+    if (isspace(static_cast<unsigned char>(*pos))) {
+      pos = skipSpaces(pos, end) - 1;
+      if (pos + 1 < end) result += ' ';
+    } else {
+      result += *pos;
+    }
   }
+  return result;
 }
 
-/**
- * Function: ingestEntireMacro
- * ---------------------------
- * A SYSCALL_DEFINE macro occasionally stretches over two or more lines.  ingestEntireMacro
- * accepts the first line of the macro and keeps reading in additional lines from the
- * provided ifstream until a close parenthesis is found.  ingestEntireMacro returns
- * the concatenation of the first line and all additional lines read in.
- */
-static string ingestEntireMacro(ifstream& infile, const string& firstLine) {
-  string macro = firstLine;
-  while (macro.find(')') == string::npos) {
-    string next;
-    getline(infile, next);
-    macro += next;
-  }
-  
-  return macro;
-}
+typedef vector<pair<string, systemCallSignature>> signatureList;
 
 /**
- * Function: processSystemCallSignature
- * ------------------------------------
- * Digs into the provided macros to pull out its name and argument count (via processNameAndArgumentCount), ensures that
- * the system call has a place in the provided systemCallSignatures and systemCallNames map, and then proceeds to
- * ensure that the relevant entry within systemCallSignatures reflects this argument count and the data types expected (relying
- * on the scParamType to distinguish the types to the extent we need to).
- */
-static void processSystemCallSignature(const string& macro, map<string, systemCallSignature>& systemCallSignatures, const map<string, int>& systemCallNames) {
-  pair<string, int> p = processNameAndArgumentCount(macro, systemCallSignatures);
-  const string& name = trim(p.first);
-  int numArguments = p.second;
-  if (systemCallNames.find(name) == systemCallNames.cend() ||
-      systemCallSignatures.find(name) != systemCallSignatures.cend()) return; // either don't know the system call or we've already processed it
-  
-  systemCallSignatures[name]; // trivially add an zero-arg signature
-  if (numArguments == 0) return; 
-  processSystemCallArguments(macro, numArguments, systemCallSignatures[name]);
-}
-
-/**
- * Constant: kSystemCallNameAndArgumentCountPattern
- * ------------------------------------------------
+ * Function: scanKernelSourceFile
+ * ------------------------------
  * The signatures of all of the system calls are sprinkled throughout all of the .h files, but
  * the signatures are also supplied by a collection of highly structured C macro throughout the
  * linux kernel source tree.  Specifically, these macros all look like this:
@@ -257,31 +179,46 @@ static void processSystemCallSignature(const string& macro, map<string, systemCa
  * always come in pairs, e.g. SYSCALL_DEFINE2 takes 4 additional arguments, where each pair provided the type and
  * name of a parameter.
  *
- * kSystemCallNameAndArgumentCountPattern is concerned only with the extraction of the argument count as a way of identifying
- * whether more sophisticated parsing is necessary to infer a full prototype.
- *
- * Breakdown of \\s*SYSCALL_DEFINE([0-6]).* is actually fairly straightforward:
- * 
- *    \\s* matches any leading whitespace preceding the macro name
- *    SYSCALL_DEFINE matches precisely that: SYSCALL_DEFINE
- *    [0-6] matches a single digit character between 0 and 6, inclusive
- *    \\s*\\( matches any whitespace followed by an opening parenthesis
- *    .* matches everything beyond the opening parenthesis
+ * scanKernelSourceFile reads the named file in one gulp and walks it with memmem looking for
+ * SYSCALL_DEFINE[0-6] at the start of a line (after optional whitespace).  For each one it splits
+ * everything between the parentheses (which may span several lines) on commas, and appends the
+ * system call's name and normalized parameter types to found, in the order they appear.  Macros
+ * whose argument count doesn't match their digit are skipped.
  */
-static const string kSystemCallNameAndArgumentCountPattern = "\\s*SYSCALL_DEFINE[0-6]\\s*\\(.*";
-static void processSignaturesWithinKernelSourceFile(const string& sourceFileName, 
-                                                    map<string, systemCallSignature>& systemCallSignatures, 
-                                                    const map<string, int>& systemCallNames) {
-  ifstream infile(sourceFileName);
-  regex re(kSystemCallNameAndArgumentCountPattern);
-  while (true) {
-    string line;
-    getline(infile, line);
-    if (infile.fail()) break;
-    if (regex_match(line, re)) {
-      string macro = ingestEntireMacro(infile, line);
-      processSystemCallSignature(macro, systemCallSignatures, systemCallNames);
+static void scanKernelSourceFile(const string& sourceFileName, signatureList& found) {
+  ifstream infile(sourceFileName, ios::binary);
+  string contents((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+  static const string kMacro = "SYSCALL_DEFINE";
+  const char *start = contents.data(), *end = start + contents.size();
+  for (const char *pos = start; pos < end; pos++) {
+    pos = static_cast<const char *>(memmem(pos, end - pos, kMacro.data(), kMacro.size()));
+    if (pos == NULL) break;
+
+    const char *lineStart = pos;
+    while (lineStart > start && lineStart[-1] != '\n' && isspace(static_cast<unsigned char>(lineStart[-1]))) lineStart--;
+    if (lineStart > start && lineStart[-1] != '\n') continue;
+
+    const char *cursor = pos + kMacro.size();
+    if (cursor == end || *cursor < '0' || *cursor > '6') continue;
+    size_t numArguments = *cursor++ - '0';
+    cursor = skipSpaces(cursor, end);
+    if (cursor == end || *cursor != '(') continue;
+    const char *close = static_cast<const char *>(memchr(cursor, ')', end - cursor));
+    if (close == NULL) break;
+
+    vector<string> tokens;
+    for (const char *tokenStart = cursor + 1; tokenStart <= close; ) {
+      const char *comma = static_cast<const char *>(memchr(tokenStart, ',', close - tokenStart));
+      const char *tokenEnd = comma == NULL ? close : comma;
+      tokens.push_back(normalizeSpaces(tokenStart, tokenEnd));
+      tokenStart = tokenEnd + 1;
     }
+    if (tokens.size() != 2 * numArguments + 1 || tokens[0].empty()) continue;
+
+    systemCallSignature signature;
+    for (size_t i = 0; i < numArguments; i++) signature.push_back(normalizeType(tokens[2 * i + 1]));
+    found.push_back(make_pair(tokens[0], signature));
+    pos = close;
   }
 }
 
@@ -327,21 +264,43 @@ static void cacheSignatures(const map<string, systemCallSignature>& systemCallSi
 /**
  * Function: processAllKernelSourceFiles
  * -------------------------------------
- * Reads the list of kernel source files printed by the supplied subprocess and parses each one, looking for
- * SYSCALL_DEFINE[0-6] macros.  Most of the work is done by processSignaturesWithinKernelSourceFile.  The code
- * exposed in this function is pretty self-explanatory.
+ * Reads the list of kernel source files printed by the supplied subprocess, and then scans them
+ * (see scanKernelSourceFile) on as many threads as there are CPUs.  Each thread claims the next
+ * unscanned file until there are none left, and records what it finds under that file's position
+ * in the list, so the merge below sees every signature in the same order a sequential scan would
+ * have, and the first definition of each known system call wins.
  */
 static void processAllKernelSourceFiles(const subprocess_t& sp, map<string, systemCallSignature>& systemCallSignatures, const map<string, int>& systemCallNames) {
   stdio_filebuf<char> processbuf(sp.ingestfd, ios::in);
   istream instream(&processbuf); // wrap the ingest file descriptor in a C++ istream so we can more easily parse each file line by line.
+  vector<string> sourceFileNames;
   while (true) {
     string sourceFileName;
     getline(instream, sourceFileName);
     if (instream.fail()) break;
-    processSignaturesWithinKernelSourceFile(sourceFileName, systemCallSignatures, systemCallNames);
+    sourceFileNames.push_back(sourceFileName);
   }
-
   waitpid(sp.pid, NULL, 0);
+
+  vector<signatureList> found(sourceFileNames.size());
+  atomic<size_t> next(0);
+  size_t numThreads = max(1u, thread::hardware_concurrency());
+  vector<thread> scanners;
+  for (size_t i = 0; i < numThreads; i++) {
+    scanners.push_back(thread([&]() {
+      for (size_t file = next++; file < sourceFileNames.size(); file = next++)
+        scanKernelSourceFile(sourceFileNames[file], found[file]);
+    }));
+  }
+  for (thread& scanner: scanners) scanner.join();
+
+  for (const signatureList& signatures: found) {
+    for (const pair<string, systemCallSignature>& p: signatures) {
+      if (systemCallNames.find(p.first) == systemCallNames.cend() ||
+          systemCallSignatures.find(p.first) != systemCallSignatures.cend()) continue; // either don't know the system call or we've already processed it
+      systemCallSignatures[p.first] = p.second;
+    }
+  }
 }
 
 /**
@@ -359,7 +318,7 @@ static void collectSystemCallSignatures(map<string, systemCallSignature>& system
                                /* supplyChildInput = */ false, 
                                /* ingestChildOutput = */ true);
   cout << "Extracting system call signature information from " << kKernelSourceCodeDirectory << "..." << endl;
-  cout << "Expect to wait about a minute..... " << flush;
+  cout << "Expect to wait a few seconds..... " << flush;
   processAllKernelSourceFiles(sp, systemCallSignatures, systemCallNames);
   cacheSignatures(systemCallSignatures);
   cout << "done!" << endl;
@@ -380,3 +339,186 @@ void compileSystemCallData(map<int, string>& systemCallNumbers,
   collectSystemCallNumbers(systemCallNumbers, systemCallNames);
   collectSystemCallSignatures(systemCallSignatures, systemCallNames, rebuild);
 }
+
+/**
+ * Constants: kBinaryCacheFilename, kBinaryCacheMagic, kAddressReturningSystemCalls
+ * --------------------------------------------------------------------------------
+ * The binary cache is a cacheHeader, followed by one systemCallTable::entry per system call
+ * number, followed by a pool of NUL-terminated names that starts with an empty one (which is
+ * the name every unused number points to).  The stamps record the modification times of the
+ * two files the table was compiled from, in nanoseconds, so a stale cache is never trusted.
+ */
+static const string kBinaryCacheFilename = ".trace_signatures.bin";
+static const char kBinaryCacheMagic[8] = {'t', 'r', 'a', 'c', 'e', 's', 'c', '1'};
+static const char *const kAddressReturningSystemCalls[] = {"brk", "mmap", NULL};
+
+struct cacheHeader {
+  char magic[sizeof(kBinaryCacheMagic)];
+  uint32_t numEntries;
+  uint32_t stringsSize;
+  uint64_t numbersStamp;
+  uint64_t signaturesStamp;
+};
+
+static uint64_t modificationStamp(const string& filename) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) < 0) return 0;
+  return info.st_mtim.tv_sec * 1000000000ULL + info.st_mtim.tv_nsec;
+}
+
+const size_t systemCallTable::kMaxArguments;
+const systemCallTable::entry systemCallTable::kUnknown = {0, -1, {0}, 0};
+
+systemCallTable::systemCallTable() : entries(&kUnknown), numEntries(0), strings(""), mapping(NULL), mappingSize(0) {}
+
+systemCallTable::~systemCallTable() {
+  unmap();
+}
+
+void systemCallTable::unmap() {
+  if (mapping != NULL) munmap(mapping, mappingSize);
+  mapping = NULL;
+  mappingSize = 0;
+}
+
+/**
+ * Method: adopt
+ * -------------
+ * Points entries and strings into the cache image starting at base, which
+ * is expected to have been validated already.
+ */
+void systemCallTable::adopt(const char *base) {
+  const cacheHeader *header = reinterpret_cast<const cacheHeader *>(base);
+  numEntries = header->numEntries;
+  entries = reinterpret_cast<const entry *>(base + sizeof(cacheHeader));
+  strings = base + sizeof(cacheHeader) + numEntries * sizeof(entry);
+}
+
+/**
+ * Method: mapCache
+ * ----------------
+ * Maps kBinaryCacheFilename, and adopts it if it's well formed and at least as new as
+ * the files it was compiled from.  Returns true if and only if the table is now usable.
+ */
+bool systemCallTable::mapCache() {
+  int fd = open(kBinaryCacheFilename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat info;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(cacheHeader))
+    base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return false;
+
+  size_t size = info.st_size;
+  const cacheHeader *header = static_cast<const cacheHeader *>(base);
+  const entry *candidates = reinterpret_cast<const entry *>(header + 1);
+  const char *pool = reinterpret_cast<const char *>(candidates + header->numEntries);
+  bool valid = memcmp(header->magic, kBinaryCacheMagic, sizeof(kBinaryCacheMagic)) == 0 &&
+    header->stringsSize > 0 &&
+    size == sizeof(cacheHeader) + header->numEntries * sizeof(entry) + header->stringsSize &&
+    header->numbersStamp == modificationStamp(kUniversalStandardAbsoluteFilename) &&
+    header->signaturesStamp == modificationStamp(kCacheFilename) &&
+    pool[0] == '\0' && pool[header->stringsSize - 1] == '\0';
+  for (uint32_t i = 0; valid && i < header->numEntries; i++)
+    valid = candidates[i].nameOffset < header->stringsSize &&
+      candidates[i].numArguments <= (int8_t) kMaxArguments;
+  if (!valid) {
+    munmap(base, size);
+    return false;
+  }
+
+  unmap();
+  mapping = base;
+  mappingSize = size;
+  image.clear();
+  adopt(static_cast<const char *>(base));
+  return true;
+}
+
+/**
+ * Function: compileCacheImage
+ * ---------------------------
+ * Lays out the binary cache for the supplied maps, as described with kBinaryCacheFilename.
+ */
+static vector<char> compileCacheImage(const map<int, string>& systemCallNumbers,
+                                      const map<string, systemCallSignature>& systemCallSignatures) {
+  size_t numEntries = systemCallNumbers.empty() ? 0 : systemCallNumbers.rbegin()->first + 1;
+  vector<systemCallTable::entry> entries(numEntries);
+  string pool(1, '\0');
+  for (systemCallTable::entry& e: entries) {
+    memset(&e, 0, sizeof(e));
+    e.numArguments = -1;
+  }
+
+  for (const pair<const int, string>& p: systemCallNumbers) {
+    if (p.first < 0) continue;
+    systemCallTable::entry& e = entries[p.first];
+    e.nameOffset = pool.size();
+    pool += p.second;
+    pool += '\0';
+    e.numArguments = 0;
+    auto found = systemCallSignatures.find(p.second);
+    if (found != systemCallSignatures.cend()) {
+      e.numArguments = min(found->second.size(), systemCallTable::kMaxArguments);
+      for (int i = 0; i < e.numArguments; i++) e.types[i] = found->second[i];
+    }
+    for (size_t i = 0; kAddressReturningSystemCalls[i] != NULL; i++)
+      if (p.second == kAddressReturningSystemCalls[i]) e.returnsAddress = 1;
+  }
+
+  cacheHeader header;
+  memcpy(header.magic, kBinaryCacheMagic, sizeof(kBinaryCacheMagic));
+  header.numEntries = numEntries;
+  header.stringsSize = pool.size();
+  header.numbersStamp = modificationStamp(kUniversalStandardAbsoluteFilename);
+  header.signaturesStamp = modificationStamp(kCacheFilename);
+
+  vector<char> image(sizeof(header) + numEntries * sizeof(systemCallTable::entry) + pool.size());
+  memcpy(image.data(), &header, sizeof(header));
+  if (numEntries > 0) memcpy(image.data() + sizeof(header), entries.data(), numEntries * sizeof(systemCallTable::entry));
+  memcpy(image.data() + sizeof(header) + numEntries * sizeof(systemCallTable::entry), pool.data(), pool.size());
+  return image;
+}
+
+/**
+ * Function: writeCacheImage
+ * -------------------------
+ * Writes image to a temporary file and renames it over kBinaryCacheFilename, so a
+ * concurrent trace either sees the old cache or the new one, never half of one.
+ */
+static bool writeCacheImage(const vector<char>& image) {
+  string temporary = kBinaryCacheFilename + "." + to_string(getpid());
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+  size_t written = 0;
+  while (written < image.size()) {
+    ssize_t n = write(fd, image.data() + written, image.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    written += n;
+  }
+  bool success = close(fd) == 0 && written == image.size() &&
+    rename(temporary.c_str(), kBinaryCacheFilename.c_str()) == 0;
+  if (!success) unlink(temporary.c_str());
+  return success;
+}
+
+void systemCallTable::load(bool rebuild) throw (MissingFileException) {
+  if (!rebuild && mapCache()) return;
+  map<int, string> systemCallNumbers;
+  map<string, int> systemCallNames;
+  map<string, systemCallSignature> systemCallSignatures;
+  compileSystemCallData(systemCallNumbers, systemCallNames, systemCallSignatures, rebuild);
+  vector<char> compiled = compileCacheImage(systemCallNumbers, systemCallSignatures);
+  if (writeCacheImage(compiled) && mapCache()) return;
+  unmap();
+  image.swap(compiled);
+  adopt(image.data());
+}
+
+int systemCallTable::lookup(const string& name) const {
+  for (size_t i = 0; i < numEntries; i++)
+    if (entries[i].numArguments >= 0 && name == strings + entries[i].nameOffset) return i;
+  return -1;
+}
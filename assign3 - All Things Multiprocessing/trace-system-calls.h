@@ -6,9 +6,13 @@
  */
  
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <map>
+#include <string>
 #include <vector>
 #include <ostream>
+#include "trace-exception.h"
 
 /**
  * Type: scParamType
@@ -49,6 +53,88 @@ std::istream& operator>>(std::istream& is, scParamType& type);
  */
 typedef std::vector<scParamType> systemCallSignature;
 
+/**
+ * Class: systemCallTable
+ * ----------------------
+ * Flat, number-indexed view of every system call's name and signature, which is what
+ * trace consults on every stop.  All of it lives in a compact binary cache file that
+ * load maps into memory, so once the cache exists, startup is one open and one mmap,
+ * and every lookup by number is a bounds check and an array index.
+ *
+ * The cache is rebuilt whenever it's missing, malformed, or older than the files it
+ * was compiled from (the system's unistd_64.h and the text signature cache described
+ * with compileSystemCallData below), and always when load is told to rebuild.
+ */
+class systemCallTable {
+ public:
+  static const size_t kMaxArguments = 6;
+
+/**
+ * Type: entry
+ * -----------
+ * One system call as laid out in the binary cache.  nameOffset locates the name in
+ * the cache's string pool, and numArguments is -1 for numbers no system call uses.
+ */
+  struct entry {
+    uint32_t nameOffset;
+    int8_t numArguments;
+    uint8_t types[kMaxArguments]; // scParamType values
+    uint8_t returnsAddress;       // nonzero for brk and mmap
+  };
+
+  systemCallTable();
+  ~systemCallTable();
+
+/**
+ * Method: load
+ * ------------
+ * Maps the binary cache into memory, compiling it first if need be.  If the cache file
+ * can't be written, the freshly compiled table is used straight from memory instead.
+ * Throws a MissingFileException if the source files aren't available.
+ */
+  void load(bool rebuild) throw (MissingFileException);
+
+/**
+ * Methods: size, isSystemCall, getEntry, getName
+ * ----------------------------------------------
+ * size returns one more than the largest system call number.  getEntry and getName
+ * may be called with any number: numbers no system call uses come back with no name
+ * and no arguments.
+ */
+  size_t size() const { return numEntries; }
+  bool isSystemCall(int number) const { return getEntry(number).numArguments >= 0; }
+  const entry& getEntry(int number) const {
+    return number >= 0 && (size_t) number < numEntries ? entries[number] : kUnknown;
+  }
+  const char *getName(int number) const {
+    return number >= 0 && (size_t) number < numEntries ? strings + entries[number].nameOffset : "";
+  }
+
+/**
+ * Method: lookup
+ * --------------
+ * Returns the number of the named system call, or -1 if there's no such system call.
+ * This one's a linear scan, and is meant for command line processing, not tracing.
+ */
+  int lookup(const std::string& name) const;
+
+ private:
+  static const entry kUnknown;
+  const entry *entries;
+  size_t numEntries;
+  const char *strings;
+  void *mapping;
+  size_t mappingSize;
+  std::vector<char> image; // the table itself, when it couldn't be mapped from the cache
+
+  bool mapCache();
+  void adopt(const char *base);
+  void unmap();
+
+  systemCallTable(const systemCallTable& original) = delete;
+  systemCallTable& operator=(const systemCallTable& rhs) = delete;
+};
+
 /**
  * Function: compileSystemCallData
  * -------------------------------
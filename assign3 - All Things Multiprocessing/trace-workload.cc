@@ -0,0 +1,100 @@
+/**
+ * File: trace-workload.cc
+ * -----------------------
+ * Presents the tracees trace-bench runs natively and under trace.  Each workload
+ * makes the same system calls over and over, so the time trace adds to a run is
+ * almost all per-system-call overhead:
+ *
+ *    getpid: a tight loop of getpid, the cheapest system call there is
+ *    small-rw: 64-byte reads from /dev/zero and writes to /dev/null
+ *    large-rw: 1MB reads from /dev/zero and writes to /dev/null
+ *    open-stat: openat, fstat, close, and stat on a long, many-component path,
+ *               which trace has to copy out of the tracee every time
+ *    storm: kStormThreads threads making getppid calls as fast as they can
+ *
+ *    > ./trace-workload <workload> [iterations]
+ *
+ * Without an iteration count, each workload runs long enough to take a second
+ * or two under a full trace on a typical machine.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+using namespace std;
+
+static const size_t kSmallBufferSize = 64;
+static const size_t kLargeBufferSize = 1 << 20;
+static const size_t kStormThreads = 4;
+static const string kPathHeavyFile = "/usr/lib/../bin/../lib/../bin/../lib/../bin/../lib/../bin/env";
+
+static void getpidLoop(size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) syscall(SYS_getpid); // glibc doesn't cache it, but be sure
+}
+
+static void readWriteLoop(size_t iterations, size_t size) {
+  vector<char> buffer(size);
+  int zero = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+  int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  for (size_t i = 0; i < iterations; i++) {
+    if (read(zero, buffer.data(), size) < 0 || write(null, buffer.data(), size) < 0) break;
+  }
+  close(zero);
+  close(null);
+}
+
+static void openStatLoop(size_t iterations) {
+  struct stat info;
+  for (size_t i = 0; i < iterations; i++) {
+    int fd = open(kPathHeavyFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      fstat(fd, &info);
+      close(fd);
+    }
+    stat(kPathHeavyFile.c_str(), &info);
+  }
+}
+
+static void stormLoop(size_t iterations) {
+  vector<thread> threads;
+  for (size_t t = 0; t < kStormThreads; t++) {
+    threads.push_back(thread([iterations]() {
+      for (size_t i = 0; i < iterations / kStormThreads; i++) syscall(SYS_getppid);
+    }));
+  }
+  for (thread& t: threads) t.join();
+}
+
+struct workload {
+  const char *name;
+  size_t defaultIterations;
+  void (*run)(size_t iterations);
+};
+
+static const workload kWorkloads[] = {
+  {"getpid", 200000, getpidLoop},
+  {"small-rw", 100000, [](size_t iterations) { readWriteLoop(iterations, kSmallBufferSize); }},
+  {"large-rw", 5000, [](size_t iterations) { readWriteLoop(iterations, kLargeBufferSize); }},
+  {"open-stat", 50000, openStatLoop},
+  {"storm", 200000, stormLoop},
+};
+
+int main(int argc, char *argv[]) {
+  for (const workload& w: kWorkloads) {
+    if (argc < 2 || strcmp(argv[1], w.name) != 0) continue;
+    w.run(argc > 2 ? strtoul(argv[2], NULL, 10) : w.defaultIterations);
+    return 0;
+  }
+
+  cerr << "Usage: " << argv[0] << " <workload> [iterations], where workload is one of:";
+  for (const workload& w: kWorkloads) cerr << " " << w.name;
+  cerr << endl;
+  return 1;
+}
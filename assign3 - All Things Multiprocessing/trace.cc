@@ -13,105 +13,683 @@
 #include <cassert>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <csignal>
+#include <dirent.h> // for opendir, readdir
 #include <unistd.h> // for fork, execvp
 #include <string.h> // for memchr, strerror
 #include <sys/ptrace.h>
-#include <sys/reg.h>
+#include <sys/uio.h> // for process_vm_readv
+#include <sys/prctl.h>
+#include <stddef.h> // for offsetof
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/time.h> // for setitimer
+#include <sys/user.h> // for user_regs_struct
 #include <sys/wait.h>
 #include "trace-options.h"
 #include "trace-error-constants.h"
 #include "trace-system-calls.h"
+#include "trace-stats.h"
+#include "trace-record.h"
+#include "trace-format.h"
 #include "trace-exception.h"
 using namespace std;
 
+static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+
+/**
+ * Function: read_tracee_memory
+ * ----------------------------
+ * Copies up to len bytes starting at addr in the tracee's address space into buf,
+ * and returns how many bytes were copied (0 if addr isn't readable).  A single
+ * process_vm_readv does the whole copy; len should not cross a page boundary,
+ * since process_vm_readv fails outright rather than stopping at an unmapped page.
+ * If process_vm_readv isn't permitted or isn't supported, we fall back to
+ * PTRACE_PEEKDATA, one aligned word at a time, from then on.
+ */
+static size_t read_tracee_memory(pid_t pid, unsigned long addr, char *buf, size_t len)
+{
+  static bool vm_readv_works = true;
+  if (vm_readv_works)
+  {
+    struct iovec local = {buf, len};
+    struct iovec remote = {(void *) addr, len};
+    ssize_t count = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    if (count >= 0) return count;
+    if (errno != EPERM && errno != ENOSYS) return 0;
+    vm_readv_works = false;
+  }
+
+  size_t copied = 0;
+  while (copied < len)
+  {
+    unsigned long word_addr = (addr + copied) & ~(sizeof(long) - 1);
+    errno = 0;
+    long word = ptrace(PTRACE_PEEKDATA, pid, word_addr, 0);
+    if (errno != 0) break;
+    size_t offset = addr + copied - word_addr;
+    size_t count = min(sizeof(long) - offset, len - copied);
+    memcpy(buf + copied, (char *) &word + offset, count);
+    copied += count;
+  }
+  return copied;
+}
+
+/**
+ * Function: process_string
+ * ------------------------
+ * Returns the NUL-terminated string at addr in the tracee.  The string is read a
+ * page at a time (the first read stops at the end of addr's page), so a string
+ * ending just before an unmapped page reads back in full and most strings cost a
+ * single system call.  A string that runs into unreadable memory is cut off there.
+ */
 static string process_string(pid_t pid, unsigned long addr)
 {
-  size_t bytes_read = 0;
-  while( !( bytes_read%(sizeof(long))) )
+  string str;
+  vector<char> chunk(kPageSize);
+  while (true)
+  {
+    size_t len = kPageSize - addr % kPageSize;
+    size_t count = read_tracee_memory(pid, addr, chunk.data(), len);
+    const char *nul = (const char *) memchr(chunk.data(), '\0', count);
+    if (nul != NULL)
+      return str.append(chunk.data(), nul - chunk.data());
+
+    str.append(chunk.data(), count);
+    if (count < len) return str;
+    addr += count;
+  }
+}
+
+/**
+ * Function: fetch_registers
+ * -------------------------
+ * Pulls every general-purpose register of the stopped tracee in a single
+ * PTRACE_GETREGS, rather than one PTRACE_PEEKUSER per register.
+ */
+static struct user_regs_struct fetch_registers(pid_t pid)
+{
+  struct user_regs_struct regs;
+  ptrace(PTRACE_GETREGS, pid, 0, &regs);
+  return regs;
+}
+
+/**
+ * Type: pending_syscall
+ * ---------------------
+ * What we remember about a system call between its entry and exit stops.
+ */
+struct pending_syscall {
+  int number;
+  uint64_t entered;
+};
+
+/**
+ * Type: tracee
+ * ------------
+ * Per-thread tracing state.  Every thread of every process we follow gets one,
+ * keyed by its tid.
+ *
+ *  in_syscall: true between a system call's entry stop and its exit stop
+ *  awaiting_initial_stop: true for a newly attached thread until the SIGSTOP the
+ *                         kernel starts it with has been reported (and swallowed)
+ *  call: the system call in progress, if in_syscall
+ */
+struct tracee {
+  bool in_syscall;
+  bool awaiting_initial_stop;
+  pending_syscall call;
+};
+
+/**
+ * Type: tracer
+ * ------------
+ * Bundles everything the tracing loop consults: the command line options, the
+ * system call tables, every thread being traced, and where events go: to the
+ * formatter, to the recorder (in --record mode), and/or to the statistics
+ * gathered so far (in --stats mode).
+ */
+struct tracer {
+  traceOptions options;
+  systemCallTable systemCalls;
+  map<int, string> errorStrings;
+  systemCallStats stats;
+  traceRecorder recorder;
+  traceFormatter formatter;
+  unordered_map<pid_t, tracee> tracees;
+
+  tracer() : formatter(cout, systemCalls, errorStrings, /* flushEntries = */ true) {}
+};
+
+static uint64_t now_nanos()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Function: emit
+ * --------------
+ * Hands r to the recorder in --record mode, and otherwise prints it, unless
+ * we're only gathering statistics.
+ */
+static void emit(tracer& t, const traceRecord& r, const string strings[])
+{
+  if (t.recorder.isOpen())
+  {
+    t.recorder.record(r, strings);
+  }
+  else if (!t.options.stats)
   {
-    long ret = ptrace(PTRACE_PEEKDATA, pid, addr + bytes_read);
-    char *ret_chars = (char *) &ret; 
-    
-    size_t i = 0;
-    while(i < sizeof(long))
+    const char *pointers[systemCallTable::kMaxArguments];
+    for (size_t i = 0; i < systemCallTable::kMaxArguments; i++)
+      pointers[i] = strings == NULL ? NULL : strings[i].c_str();
+    t.formatter.render(r, pointers);
+  }
+}
+
+static traceRecord make_record(uint8_t kind, pid_t pid, const pending_syscall& call, uint64_t timestamp)
+{
+  traceRecord r;
+  memset(&r, 0, sizeof(r));
+  r.kind = kind;
+  r.tid = pid;
+  r.syscall = call.number;
+  r.timestamp = timestamp;
+  return r;
+}
+
+/**
+ * Function: handle_syscall_entry
+ * ------------------------------
+ * Notes the system call the tracee has just entered and, unless we're only
+ * gathering statistics, captures its arguments, along with any strings they
+ * point to (which must be read now, before the system call can change them).
+ */
+static void handle_syscall_entry(tracer& t, pid_t pid, pending_syscall& call)
+{
+  call.entered = now_nanos();
+  struct user_regs_struct regs = fetch_registers(pid);
+  call.number = regs.orig_rax;
+  if (t.options.stats && !t.recorder.isOpen()) return;
+
+  traceRecord r = make_record(traceRecord::kEntry, pid, call, call.entered);
+  const unsigned long long args[systemCallTable::kMaxArguments] = {regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9};
+  string strings[systemCallTable::kMaxArguments];
+  const systemCallTable::entry& signature = t.systemCalls.getEntry(call.number);
+  bool capture_strings = t.recorder.isOpen() || !t.options.simple;
+  for (size_t i = 0; i < systemCallTable::kMaxArguments; i++)
+  {
+    r.values[i] = args[i];
+    if (capture_strings && (int) i < signature.numArguments && signature.types[i] == SYSCALL_STRING)
     {
-      if (ret_chars[i] == '\0')
-        return "";
+      strings[i] = process_string(pid, args[i]);
+      r.stringMask |= 1 << i;
+    }
+  }
+  emit(t, r, strings);
+}
+
+/**
+ * Function: handle_syscall_exit
+ * -----------------------------
+ * Reports the system call the tracee is about to return from, and in --stats mode,
+ * records its latency and outcome.
+ */
+static void handle_syscall_exit(tracer& t, pid_t pid, const pending_syscall& call)
+{
+  uint64_t exited = now_nanos();
+  long retval = fetch_registers(pid).rax;
+  if (t.options.stats)
+    t.stats.record(call.number, exited - call.entered, retval < 0 && retval >= -4095);
+
+  traceRecord r = make_record(traceRecord::kExit, pid, call, exited);
+  r.values[0] = retval;
+  emit(t, r, NULL);
+}
+
+static void handle_no_return(tracer& t, pid_t pid, const pending_syscall& call)
+{
+  if (t.options.stats)
+    t.stats.recordUnfinished(call.number);
+  emit(t, make_record(traceRecord::kNoReturn, pid, call, now_nanos()), NULL);
+}
+
+/**
+ * Function: build_seccomp_filter
+ * ------------------------------
+ * Compiles a seccomp-bpf program that asks for the tracer (SECCOMP_RET_TRACE) on
+ * every system call listed in syscalls and allows everything else outright.  System
+ * calls made through any ABI other than x86-64's are always allowed.
+ */
+static vector<struct sock_filter> build_seccomp_filter(const set<int>& syscalls)
+{
+  vector<struct sock_filter> program = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr))
+  };
+  for (int nr: syscalls)
+  {
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned int) nr, 0, 1));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+  }
+  program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+  return program;
+}
+
+static set<int> lookup_filtered_syscalls(const vector<string>& names, const systemCallTable& systemCalls)
+{
+  set<int> syscalls;
+  for (const string& name: names)
+  {
+    int number = systemCalls.lookup(name);
+    if (number < 0)
+      throw TraceException("Unknown system call in --filter: " + name);
+    syscalls.insert(number);
+  }
+  return syscalls;
+}
 
-      cout << ret_chars[i];
-      i++;
+/**
+ * Function: resume
+ * ----------------
+ * Restarts a stopped thread, delivering signal to it if that's nonzero.  Without
+ * a filter, every thread runs from one system call stop to the next.  With one,
+ * threads run freely with PTRACE_CONT, except that a thread the filter stopped
+ * on its way into a system call is stepped to that call's exit stop.
+ */
+static void resume(tracer& t, pid_t tid, const tracee& state, int signal)
+{
+  bool step = t.options.filter.empty() || state.in_syscall;
+  ptrace(step ? PTRACE_SYSCALL : PTRACE_CONT, tid, 0, signal);
+}
+
+/**
+ * Globals: detach_requested, stop_requested, wakeup_tid
+ * -----------------------------------------------------
+ * Set asynchronously when trace is attached with -p.  SIGINT sets both flags (detach
+ * and quit), and in --sample mode, the SIGALRM ending each window sets just
+ * detach_requested.  Since trace spends its time blocked in waitpid, the handler also
+ * interrupts wakeup_tid (the process we attached to), so a signal that lands just
+ * before waitpid still gets trace to look at the flags promptly.
+ */
+static volatile sig_atomic_t detach_requested = 0;
+static volatile sig_atomic_t stop_requested = 0;
+static volatile pid_t wakeup_tid = 0;
+
+static void request_detach(int sig)
+{
+  int saved_errno = errno;
+  detach_requested = 1;
+  if (sig == SIGINT || sig == SIGTERM) stop_requested = 1;
+  if (wakeup_tid != 0) ptrace(PTRACE_INTERRUPT, wakeup_tid, 0, 0);
+  errno = saved_errno;
+}
+
+static bool is_stopping_signal(int sig)
+{
+  return sig == SIGSTOP || sig == SIGTSTP || sig == SIGTTIN || sig == SIGTTOU;
+}
+
+/**
+ * Function: trace_all
+ * -------------------
+ * Traces every thread in t.tracees (each of which has either just stopped, or is
+ * awaiting its initial stop) and every process and thread they (transitively) fork,
+ * vfork, or clone, until all of them are gone or a detach is requested, and returns
+ * root's final wait status.  The kernel attaches new threads for us
+ * (PTRACE_O_TRACEFORK and friends), and a single waitpid(-1, __WALL) loop services
+ * every stop as it's reported, so each thread only ever waits on the tracer for its
+ * own stops.
+ */
+static int trace_all(tracer& t, pid_t root)
+{
+  int root_status = 0;
+  while (!t.tracees.empty() && !detach_requested)
+  {
+    int status;
+    pid_t tid = waitpid(-1, &status, __WALL);
+    if (tid < 0)
+    {
+      if (errno == EINTR) continue;
+      break; // ECHILD: nothing left to wait for
+    }
+
+    // A thread we haven't heard about yet can report its initial stop before its
+    // parent's fork/clone event does.
+    if (t.tracees.find(tid) == t.tracees.end())
+    {
+      tracee& fresh = t.tracees[tid];
+      fresh.awaiting_initial_stop = true;
     }
-    bytes_read += i;
+    tracee& state = t.tracees[tid];
+
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      if (state.in_syscall) handle_no_return(t, tid, state.call);
+      if (tid == root) root_status = status;
+      t.tracees.erase(tid);
+      continue;
+    }
+    if (!WIFSTOPPED(status)) continue;
+
+    int signal = 0;
+    int event = status >> 16;
+    if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+    {
+      if (!state.in_syscall && t.options.filter.empty())
+      {
+        handle_syscall_entry(t, tid, state.call);
+        state.in_syscall = true;
+      }
+      else if (state.in_syscall)
+      {
+        handle_syscall_exit(t, tid, state.call);
+        state.in_syscall = false;
+      }
+    }
+    else if (event == PTRACE_EVENT_SECCOMP)
+    {
+      handle_syscall_entry(t, tid, state.call);
+      state.in_syscall = true;
+    }
+    else if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE)
+    {
+      unsigned long child;
+      ptrace(PTRACE_GETEVENTMSG, tid, 0, &child);
+      if (t.tracees.find(child) == t.tracees.end())
+        t.tracees[child].awaiting_initial_stop = true;
+    }
+    else if (event == PTRACE_EVENT_EXEC)
+    {
+      // If a thread other than the leader called execve, it now has the leader's
+      // tid, and its in-progress execve with it.
+      unsigned long former;
+      ptrace(PTRACE_GETEVENTMSG, tid, 0, &former);
+      if ((pid_t) former != tid && t.tracees.find(former) != t.tracees.end())
+      {
+        t.tracees[tid] = t.tracees[former];
+        t.tracees.erase(former);
+      }
+    }
+    else if (event == PTRACE_EVENT_STOP)
+    {
+      // Threads we seized stop this way when we interrupt them, when they're first
+      // attached, and for group-stops, during which they should stay stopped.
+      state.awaiting_initial_stop = false;
+      if (is_stopping_signal(WSTOPSIG(status)))
+      {
+        ptrace(PTRACE_LISTEN, tid, 0, 0);
+        continue;
+      }
+    }
+    else if (event == 0 && WSTOPSIG(status) == SIGSTOP && state.awaiting_initial_stop)
+    {
+      state.awaiting_initial_stop = false;
+    }
+    else if (event == 0)
+    {
+      signal = WSTOPSIG(status); // an ordinary signal: pass it along
+    }
+
+    resume(t, tid, t.tracees[tid], signal);
   }
-  return "";
+
+  t.formatter.finish();
+  return root_status;
 }
 
-static const int REGS[6] = {RDI, RSI, RDX, R10, R8, R9};
-string print_syscall_args(systemCallSignature signature, pid_t pid)
+static const long kPtraceOptions = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
+                                  PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC;
+
+/**
+ * Function: attach_all
+ * --------------------
+ * Seizes every thread of the running process pid and interrupts it, so trace_all
+ * can pick each one up at its first stop.  Threads can be created while we're
+ * seizing their siblings, so /proc/pid/task is rescanned until a pass turns up
+ * nothing new.  Returns false if the process is gone, and throws a TraceException
+ * if it can't be traced.
+ */
+static bool attach_all(tracer& t, pid_t pid)
 {
-  int n =  (int) signature.size();
-  for (int i=0; i < n; i++)
+  string tasks = "/proc/" + to_string(pid) + "/task";
+  for (bool found_new = true; found_new; )
   {
-    long val = ptrace(PTRACE_PEEKUSER, pid, REGS[i] * sizeof(long));
-    switch (signature[i]){
-      case SYSCALL_INTEGER:
-        cout << dec << (int) val;
-        break;
-      case SYSCALL_STRING:
-        cout << '"' << process_string(pid, val) << '"';
-        break;
-      case SYSCALL_POINTER:
-        if (val != 0)
-          cout << "0x" << hex << val;
-        else
-          cout << "NULL";
-        break;
-      case SYSCALL_UNKNOWN_TYPE:
-        cout << "<UNKOWN SIGNATURE>";
-        break;
-    }
-    cout << (i == n-1 ?  "" : ", ");
-  }
-  return "";
-}
-
-string full_retval(long ret, bool addr, map<int, std::string>& errorConstants)
+    found_new = false;
+    DIR *dir = opendir(tasks.c_str());
+    if (dir == NULL) return !t.tracees.empty();
+    while (struct dirent *entry = readdir(dir))
+    {
+      pid_t tid = atoi(entry->d_name);
+      if (tid <= 0 || t.tracees.find(tid) != t.tracees.end()) continue;
+      if (ptrace(PTRACE_SEIZE, tid, 0, kPtraceOptions) < 0)
+      {
+        if (errno == ESRCH) continue; // the thread just exited
+        int error = errno;
+        closedir(dir);
+        throw TraceException("Couldn't attach to process " + to_string(pid) + ": " + strerror(error));
+      }
+      ptrace(PTRACE_INTERRUPT, tid, 0, 0);
+      t.tracees[tid].awaiting_initial_stop = true;
+      found_new = true;
+    }
+    closedir(dir);
+  }
+  return !t.tracees.empty();
+}
+
+/**
+ * Function: detach_all
+ * --------------------
+ * Interrupts every thread we're tracing and detaches from each as it stops, handing
+ * back any signal it was stopped to receive, so the process carries on as if it had
+ * never been traced.  Children the tracees fork on the way out are attached by the
+ * kernel before we can stop them, so they're detached as they show up, too.
+ */
+static void detach_all(tracer& t)
 {
-  
-  if (ret >= 0)
-    if (addr)
-      cout << "0x" << hex << ret;
-    else
-      cout << dec << (int) ret;
+  for (const pair<const pid_t, tracee>& p: t.tracees)
+    ptrace(PTRACE_INTERRUPT, p.first, 0, 0);
+
+  while (!t.tracees.empty())
+  {
+    int status;
+    pid_t tid = waitpid(-1, &status, __WALL);
+    if (tid < 0)
+    {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      t.tracees.erase(tid);
+      continue;
+    }
+    if (!WIFSTOPPED(status)) continue;
+
+    int signal = 0;
+    int event = status >> 16;
+    if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE)
+    {
+      unsigned long child;
+      ptrace(PTRACE_GETEVENTMSG, tid, 0, &child);
+      t.tracees[child].awaiting_initial_stop = true;
+    }
+    else if (event == 0 && WSTOPSIG(status) != (SIGTRAP | 0x80) &&
+             !(WSTOPSIG(status) == SIGSTOP && t.tracees[tid].awaiting_initial_stop))
+    {
+      signal = WSTOPSIG(status);
+    }
+    ptrace(PTRACE_DETACH, tid, 0, signal);
+    t.tracees.erase(tid);
+  }
+  t.formatter.finish();
+}
+
+static void install_handler(int sig)
+{
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = request_detach;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0; // no SA_RESTART: waitpid should return EINTR
+  sigaction(sig, &action, NULL);
+}
+
+static bool process_exists(pid_t pid)
+{
+  return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * Function: close_recorder
+ * ------------------------
+ * Closes the --record log, if there is one.  Returns false (after saying why)
+ * if any part of the log couldn't be written, so trace can exit with a failure.
+ */
+static bool close_recorder(tracer& t)
+{
+  try {
+    t.recorder.close();
+  } catch (const TraceException& te) {
+    cerr << te.what() << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Function: trace_attached
+ * ------------------------
+ * Implements -p: traces the running process pid until it exits, or until Ctrl-C,
+ * in which case we detach and leave it running.  With --sample, we instead attach
+ * for sampleMillis out of every sampleSeconds, and SIGALRM marks the end of each
+ * window.  Returns trace's exit status.
+ */
+static int trace_attached(tracer& t)
+{
+  pid_t pid = t.options.attach;
+  if (!process_exists(pid)) {
+    cerr << "Couldn't attach to process " << pid << ": " << strerror(ESRCH) << endl;
+    return 1;
+  }
+  install_handler(SIGINT);
+  install_handler(SIGTERM);
+  install_handler(SIGALRM);
+  wakeup_tid = pid;
+
+  size_t windows = 0;
+  bool exited = false, exit_observed = false;
+  int status = 0;
+  while (!stop_requested && !exited)
+  {
+    uint64_t window_start = now_nanos();
+    try {
+      if (!attach_all(t, pid)) break;
+    } catch (const TraceException& te) {
+      cerr << te.what() << endl;
+      detach_all(t);
+      return 1;
+    }
+
+    if (t.options.sampleMillis > 0)
+    {
+      struct itimerval window = {{0, 0}, {t.options.sampleMillis / 1000, (t.options.sampleMillis % 1000) * 1000}};
+      setitimer(ITIMER_REAL, &window, NULL);
+    }
+    status = trace_all(t, pid);
+    exited = exit_observed = t.tracees.empty();
+    struct itimerval off = {{0, 0}, {0, 0}};
+    setitimer(ITIMER_REAL, &off, NULL);
+    detach_all(t);
+    windows++;
+    detach_requested = 0;
+    if (t.options.sampleMillis == 0) break;
+
+    // Sleep out the rest of the period, unless Ctrl-C cuts it short.
+    uint64_t period = t.options.sampleSeconds * 1000000000ULL;
+    uint64_t elapsed = now_nanos() - window_start;
+    if (elapsed < period && !stop_requested)
+    {
+      struct timespec rest = {(time_t) ((period - elapsed) / 1000000000), (long) ((period - elapsed) % 1000000000)};
+      nanosleep(&rest, NULL);
+    }
+    exited = exited || !process_exists(pid);
+  }
+
+  bool recorded = close_recorder(t);
+  if (t.options.stats) t.stats.print(cout, t.systemCalls);
+  if (t.options.sampleMillis > 0)
+    printf("Sampled %zu windows of %u ms from process %d\n", windows, t.options.sampleMillis, pid);
+  if (exit_observed)
+    printf("Program exited normally with status %d\n", status);
+  else if (exited)
+    printf("Process %d exited\n", pid);
   else
-    cout << "-1 " << errorConstants[abs(ret)] << " (" << strerror(abs(ret)) << ")";
-  
-  return "";
+    printf("Detached from process %d\n", pid);
+  return recorded ? 0 : 1;
 }
 
-#define BRK "brk"
-#define MMAP "mmap"
 int main(int argc, char *argv[]) {
-  bool simple = false, rebuild = false;
-  int numFlags = processCommandLineFlags(simple, rebuild, argv);
-  if (argc - numFlags == 1) {
+  tracer t;
+  int numFlags;
+  try {
+    numFlags = processCommandLineFlags(t.options, argv);
+  } catch (const TraceException& te) {
+    cerr << te.what() << endl;
+    return 1;
+  }
+  bool attaching = t.options.attach != 0;
+  if (argc - numFlags == 1 && !attaching) {
     cout << "Nothing to trace... exiting." << endl;
     return 0;
   }
-  
-  map<int, string> systemCallNumbers;
-  map<string, int> systemCallNames;
-  map<string, systemCallSignature> systemCallSignatures;
-  map<int, string> errorStrings;
+  if (argc - numFlags > 1 && attaching) {
+    cerr << "Either name a program to trace or attach to one with -p, but not both." << endl;
+    return 1;
+  }
+  if (t.options.sampleMillis > 0) t.options.stats = true;
+
+  compileSystemCallErrorStrings(t.errorStrings);
+  t.systemCalls.load(t.options.rebuild);
 
-  compileSystemCallErrorStrings(errorStrings);
-  compileSystemCallData(systemCallNumbers,systemCallNames, systemCallSignatures, rebuild);
+  t.formatter.setSimple(t.options.simple);
+  bool filtered = !t.options.filter.empty();
+  vector<struct sock_filter> filter;
+  try {
+    if (filtered) filter = build_seccomp_filter(lookup_filtered_syscalls(t.options.filter, t.systemCalls));
+    if (!t.options.record.empty()) t.recorder.open(t.options.record);
+  } catch (const TraceException& te) {
+    cerr << te.what() << endl;
+    return 1;
+  }
+  if (attaching) return trace_attached(t);
   
   pid_t pid = fork();
   if (pid == 0) {
     ptrace(PTRACE_TRACEME);
     raise(SIGSTOP);
+    if (filtered) {
+      // Installed only now, once the tracer has asked for PTRACE_O_TRACESECCOMP;
+      // before that, SECCOMP_RET_TRACE would fail the system calls with ENOSYS.
+      struct sock_fprog program = {(unsigned short) filter.size(), filter.data()};
+      if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0 ||
+          prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) < 0) {
+        perror("Error installing seccomp filter");
+        _exit(1);
+      }
+    }
     execvp(argv[numFlags + 1], argv + numFlags + 1);
     return 0;
   }
@@ -119,56 +697,15 @@ int main(int argc, char *argv[]) {
   int status;
   waitpid(pid, &status, 0);
   assert(WIFSTOPPED(status));
-  ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD);
-  
-  bool poll = true;
-  while (poll)
-  {
-
-    bool addr_retval = false;
-    while (true) {
-      ptrace(PTRACE_SYSCALL, pid, 0, 0);
-      waitpid(pid, &status, 0);
-      if (WIFSTOPPED(status) && (WSTOPSIG(status) == (SIGTRAP | 0x80))) {
-        int syscall = ptrace(PTRACE_PEEKUSER, pid, ORIG_RAX * sizeof(long));
-        string syscall_name = systemCallNumbers[syscall];
-        systemCallSignature signature = systemCallSignatures[syscall_name];
-
-        if (simple)
-          cout << "syscall(" << syscall << ") = " << flush;
-        else
-          cout << syscall_name << "(" << print_syscall_args(signature, pid) << ") = " << flush;
-        
-        if ( !strcmp(syscall_name.c_str(), MMAP) || !strcmp(syscall_name.c_str(), BRK))
-          addr_retval = true;
-
-        break;
-      }
-    }
-
-    while (true) {
-      ptrace(PTRACE_SYSCALL, pid, 0, 0);
-      waitpid(pid, &status, 0);
-      if (WIFSTOPPED(status) && (WSTOPSIG(status) == (SIGTRAP | 0x80))) {
-        long retval = ptrace(PTRACE_PEEKUSER, pid, RAX * sizeof(long));
-        if (simple)
-          cout << retval << endl;
-        else
-          cout << full_retval(retval, addr_retval, errorStrings) << endl;
-        break;
-      }
+  long ptraceOptions = kPtraceOptions;
+  if (filtered) ptraceOptions |= PTRACE_O_TRACESECCOMP;
+  ptrace(PTRACE_SETOPTIONS, pid, 0, ptraceOptions);
 
-      else if (WIFEXITED(status))
-      {
-        cout << "<no return>" << flush << endl;
-        kill(pid, SIGKILL);
-        poll = false;
-        break;
-      }
-    }
-  }
-
-  waitpid(pid, &status, 0);
+  t.tracees[pid] = tracee();
+  resume(t, pid, t.tracees[pid], 0);
+  status = trace_all(t, pid);
+  bool recorded = close_recorder(t);
+  if (t.options.stats) t.stats.print(cout, t.systemCalls);
   printf("Program exited normally with status %d\n", status);
-  return 0;
+  return recorded ? 0 : 1;
 }
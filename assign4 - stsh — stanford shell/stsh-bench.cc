@@ -0,0 +1,193 @@
+/**
+ * File: stsh-bench.cc
+ * -------------------
+ * Measures how quickly stsh gets through a script of many short commands.
+ * Each workload is written out as a script, and the script is run by stsh
+ * as a script file, as a -c command, and fed through standard input to both
+ * interactive paths (with and without the readline library).  /bin/sh runs
+ * the same script for comparison.  Every figure is the median of several
+ * runs, in microseconds per command, with all output sent to /dev/null.
+ *
+ *    > ./stsh-bench [runs] [commands] [workload ...]
+ *
+ * The workloads are:
+ *
+ *    builtin: the jobs builtin, so no process is ever created
+ *    true: /bin/true, the cheapest command there is to launch
+ *    pipeline: /bin/true | /bin/true
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace std;
+
+extern char **environ;
+
+static const size_t kDefaultRuns = 3;
+static const size_t kDefaultCommands = 2000;
+static char scriptFile[] = "/tmp/stsh-bench-XXXXXX";
+static const string kStshExecutable = "./stsh";
+
+struct workload {
+  const char *name;
+  const char *command;
+};
+
+static const workload kWorkloads[] = {
+  {"builtin", "jobs"},
+  {"true", "/bin/true"},
+  {"pipeline", "/bin/true | /bin/true"},
+};
+
+/**
+ * Type: mode
+ * ----------
+ * One way of running a script: name heads its column, and argv is the command
+ * that runs it, where "@" stands for the script file and "$" for the script's
+ * contents.  If fromStdin is true, the script is fed through standard input.
+ */
+struct mode {
+  const char *name;
+  vector<string> argv;
+  bool fromStdin;
+};
+
+static const vector<mode> kModes = {
+  {"script", {kStshExecutable, "@"}, false},
+  {"-c", {kStshExecutable, "-c", "$"}, false},
+  {"stdin", {kStshExecutable, "--suppress-prompt", "--no-history"}, true},
+  {"readline", {kStshExecutable, "--suppress-prompt"}, true},
+  {"/bin/sh", {"/bin/sh", "@"}, false},
+};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Function: timeRun
+ * -----------------
+ * Runs argv to completion with its standard output and error sent to /dev/null
+ * (and its standard input taken from the script if fromStdin is true), and returns
+ * how many seconds that took, or -1 if it couldn't be run or failed.
+ */
+static double timeRun(const vector<string>& argv, bool fromStdin) {
+  vector<char *> args;
+  for (const string& arg: argv) args.push_back(const_cast<char *>(arg.c_str()));
+  args.push_back(NULL);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, fromStdin ? scriptFile : "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  double start = now();
+  pid_t pid;
+  int err = posix_spawn(&pid, args[0], &actions, NULL, args.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) return -1;
+  int status;
+  waitpid(pid, &status, 0);
+  double elapsed = now() - start;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? elapsed : -1;
+}
+
+/**
+ * Function: medianRun
+ * -------------------
+ * Returns the median of runs timed runs of argv, or -1 if any of them failed.
+ */
+static double medianRun(const vector<string>& argv, bool fromStdin, size_t runs) {
+  vector<double> times;
+  for (size_t i = 0; i < runs; i++) {
+    double elapsed = timeRun(argv, fromStdin);
+    if (elapsed < 0) return -1;
+    times.push_back(elapsed);
+  }
+  sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+/**
+ * Function: writeScript
+ * ---------------------
+ * Writes count copies of command, one per line, to the script file, and
+ * returns the script's contents.
+ */
+static string writeScript(const string& command, size_t count) {
+  string script;
+  for (size_t i = 0; i < count; i++) script += command + "\n";
+  ofstream out(scriptFile);
+  out << script;
+  return script;
+}
+
+int main(int argc, char *argv[]) {
+  int fd = mkstemp(scriptFile);
+  if (fd < 0) {
+    perror("Couldn't create script file");
+    return 1;
+  }
+  close(fd);
+
+  size_t runs = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultRuns;
+  size_t commands = argc > 2 ? strtoul(argv[2], NULL, 10) : kDefaultCommands;
+  if (runs == 0 || commands == 0) {
+    cerr << "Usage: " << argv[0] << " [runs] [commands] [workload ...]" << endl;
+    unlink(scriptFile);
+    return 1;
+  }
+  vector<string> names;
+  for (int i = 3; i < argc; i++) names.push_back(argv[i]);
+  if (names.empty()) {
+    for (const workload& w: kWorkloads) names.push_back(w.name);
+  }
+
+  cout << "microseconds per command, " << commands << " commands per script" << endl;
+  cout << setw(10) << "workload";
+  for (const mode& m: kModes) cout << setw(10) << m.name;
+  cout << endl << fixed << setprecision(1);
+
+  int result = 0;
+  for (const string& name: names) {
+    const workload *w = find_if(begin(kWorkloads), end(kWorkloads),
+                                [&name](const workload& w) { return name == w.name; });
+    if (w == end(kWorkloads)) {
+      cerr << "Unknown workload: " << name << endl;
+      result = 1;
+      continue;
+    }
+
+    string script = writeScript(w->command, commands);
+    cout << setw(10) << name << flush;
+    for (const mode& m: kModes) {
+      vector<string> command;
+      for (const string& arg: m.argv)
+        command.push_back(arg == "@" ? string(scriptFile) : arg == "$" ? script : arg);
+      double elapsed = medianRun(command, m.fromStdin, runs);
+      if (elapsed < 0) {
+        cout << setw(10) << "failed" << flush;
+        result = 1;
+      } else {
+        cout << setw(10) << elapsed / commands * 1e6 << flush;
+      }
+    }
+    cout << endl;
+  }
+
+  unlink(scriptFile);
+  return result;
+}
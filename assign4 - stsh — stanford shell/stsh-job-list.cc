@@ -14,8 +14,10 @@ using namespace std;
 STSHJob STSHJobList::njob; // njob stands for no-job
 
 STSHJob& STSHJobList::addJob(const STSHJobState& state) {
-  jobs[next] = STSHJob(next, state);
-  return jobs[next++];
+  STSHJob& job = jobs[next] = STSHJob(next, state);
+  job.processIndex = &processIndex;
+  next++;
+  return job;
 }
 
 bool STSHJobList::hasForegroundJob() const {
@@ -57,14 +59,8 @@ bool STSHJobList::containsProcess(pid_t pid) const {
 }
 
 STSHJob& STSHJobList::getJobWithProcess(pid_t pid) {
-  for (pair<const size_t, STSHJob>& p: jobs) {
-    STSHJob& job = p.second;    
-    if (job.containsProcess(pid)) {
-      return job;
-    }
-  }
-  
-  return njob;
+  STSHProcessIndex::const_iterator found = processIndex.find(pid);
+  return found == processIndex.cend() ? njob : *found->second;
 }
 
 const STSHJob& STSHJobList::getJobWithProcess(pid_t pid) const {
@@ -85,15 +81,30 @@ void STSHJobList::synchronize(STSHJob& job) {
     job.setState(kBackground); // make sure it's not categorized as foreground
   }
   
-  for (const STSHProcess& process: processes) {
-    if (process.getState() != kTerminated) {
-      return;
-    }
-  }
-  
+  if (!job.isFinished()) return;
+  unindex(job);
   jobs.erase(job.getNum());
 }
 
+/**
+ * Removes the job's processes from the pid index.  A pid whose process
+ * was reaped long ago may since have been reused by a process in some
+ * newer job, so an entry is only removed if it still refers to this job.
+ */
+void STSHJobList::unindex(const STSHJob& job) {
+  for (const STSHProcess& process: job.getProcesses()) {
+    STSHProcessIndex::iterator found = processIndex.find(process.getID());
+    if (found != processIndex.end() && found->second == &job) processIndex.erase(found);
+  }
+}
+
+void STSHJobList::printUsage(ostream& os) const {
+  for (const pair<const size_t, STSHJob>& p: jobs) {
+    os << p.second << endl;
+    p.second.printUsage(os);
+  }
+}
+
 ostream& operator<<(ostream& os, const STSHJobList& joblist) {
   for (const pair<size_t, STSHJob>& p: joblist.jobs) 
     os << p.second << endl;
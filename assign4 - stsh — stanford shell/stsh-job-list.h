@@ -101,6 +101,8 @@ public:
  * -----------------------
  * Returns true iff some process within some
  * job within the job list has the specified pid.
+ * Processes are indexed by pid as they're added to
+ * jobs, so this runs in constant time.
  */
   bool containsProcess(pid_t pid) const;
 
@@ -108,9 +110,9 @@ public:
  * Method: getJobWithProcess
  * -------------------------
  * Returns a reference to the job that includes the process
- * identified by the specified pid.  Calls to this function
- * should be guarded by calls to containsProcess, because
- * when the specified pid doesn't exist, the behavior here
+ * identified by the specified pid, in constant time.  Calls
+ * to this function should be guarded by calls to containsProcess,
+ * because when the specified pid doesn't exist, the behavior here
  * isn't defined.
  */
   STSHJob& getJobWithProcess(pid_t pid);
@@ -127,9 +129,20 @@ public:
  * a foreground job).
  */  
   void synchronize(STSHJob& job);
+
+/**
+ * Method: printUsage
+ * ------------------
+ * Prints every job, just as operator<< does, but follows each one with
+ * the table of resource usage STSHJob::printUsage prints (see jobs -l).
+ */
+  void printUsage(std::ostream& os) const;
   
 private:
   size_t next = 1;
   std::map<size_t, STSHJob> jobs; // maps work, because we want to publish in order of job number
+  STSHProcessIndex processIndex;  // pid -> job holding it; map nodes don't move, so the pointers stay valid
   static STSHJob njob;
+
+  void unindex(const STSHJob& job);
 };
@@ -5,12 +5,18 @@
  */
 
 #include "stsh-job.h"
-#include <iomanip> // for setw
-#include <sstream> // for ostringstream
+#include <algorithm> // for max, min
+#include <iomanip>   // for setw
+#include <sstream>   // for ostringstream
 using namespace std;
 
 STSHProcess STSHJob::nprocess;
 
+void STSHJob::addProcess(const STSHProcess& process) {
+  processes.push_back(process);
+  if (processIndex != NULL) (*processIndex)[process.getID()] = this;
+}
+
 bool STSHJob::containsProcess(pid_t pid) const {
   const STSHProcess& process = getProcess(pid);
   return &process != &nprocess;
@@ -30,6 +36,77 @@ const STSHProcess& STSHJob::getProcess(pid_t pid) const {
   return const_cast<STSHJob *>(this)->getProcess(pid);
 }
 
+bool STSHJob::isFinished() const {
+  for (const STSHProcess& process: processes) {
+    if (process.getState() != kTerminated) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void addTime(struct timeval& total, const struct timeval& time) {
+  total.tv_sec += time.tv_sec;
+  total.tv_usec += time.tv_usec;
+  if (total.tv_usec >= 1000000) {
+    total.tv_sec++;
+    total.tv_usec -= 1000000;
+  }
+}
+
+struct rusage STSHJob::getUsage() const {
+  struct rusage total = rusage();
+  for (const STSHProcess& process: processes) {
+    const struct rusage& usage = process.getUsage();
+    addTime(total.ru_utime, usage.ru_utime);
+    addTime(total.ru_stime, usage.ru_stime);
+    total.ru_maxrss = max(total.ru_maxrss, usage.ru_maxrss);
+    total.ru_nvcsw += usage.ru_nvcsw;
+    total.ru_nivcsw += usage.ru_nivcsw;
+  }
+
+  return total;
+}
+
+double STSHJob::getWallTime() const {
+  if (processes.empty()) return 0;
+  double start = processes[0].getStartTime();
+  double end = start;
+  for (const STSHProcess& process: processes) {
+    start = min(start, process.getStartTime());
+    end = max(end, process.getStartTime() + process.getWallTime());
+  }
+
+  return end - start;
+}
+
+static ostream& printUsageRow(ostream& os, const string& label, const struct rusage& usage, double wallTime) {
+  os << setw(7) << label
+     << setw(10) << wallTime << "s"
+     << setw(10) << usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 << "s"
+     << setw(10) << usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6 << "s"
+     << setw(9) << usage.ru_maxrss << "KB"
+     << setw(8) << usage.ru_nvcsw
+     << setw(8) << usage.ru_nivcsw;
+  return os;
+}
+
+void STSHJob::printUsage(ostream& os) const {
+  ios_base::fmtflags flags = os.flags();
+  streamsize precision = os.precision();
+  os << fixed << setprecision(3);
+  os << setw(7) << "pid" << setw(11) << "real" << setw(11) << "user" << setw(11) << "sys"
+     << setw(11) << "maxrss" << setw(8) << "vcsw" << setw(8) << "ivcsw" << "  command" << endl;
+  for (const STSHProcess& process: processes) {
+    printUsageRow(os, to_string(process.getID()), process.getUsage(), process.getWallTime());
+    os << "  " << process.getCommandLine() << endl;
+  }
+  printUsageRow(os, "total", getUsage(), getWallTime()) << endl;
+  os.flags(flags);
+  os.precision(precision);
+}
+
 ostream& operator<<(ostream& os, const STSHJob& job) {
   ostringstream oss;
   oss << "[" << job.num << "]";
@@ -22,9 +22,11 @@
 
 #pragma once
 #include "stsh-process.h"
-#include <cstddef>  // for size_t
-#include <vector>   // for vector
-#include <iostream> // for ostream
+#include <cstddef>        // for size_t
+#include <vector>         // for vector
+#include <unordered_map>  // for unordered_map
+#include <iostream>       // for ostream
+#include <sys/types.h>    // for pid_t
 
 /**
  * Enumerated Type: STSHJobState
@@ -37,6 +39,16 @@
  */
 enum STSHJobState { kForeground, kBackground };
 
+class STSHJob;
+
+/**
+ * Type: STSHProcessIndex
+ * ----------------------
+ * Maps the pid of every process in a job list to the job that owns it, so
+ * the job list can find a process's job without scanning every job.
+ */
+typedef std::unordered_map<pid_t, STSHJob *> STSHProcessIndex;
+
 class STSHJob {
 
 /**
@@ -56,14 +68,14 @@ public:
  * Default constructor, where the job number is just set to 0 (with the understanding
  * that all legitimate job numbers are actually supposed to be positive).
  */
-  STSHJob(): num(0) {}
+  STSHJob(): num(0), timed(false), processIndex(NULL) {}
 
 /**
  * Constructor: STSHJob
  * --------------------
  * Constructs an instance of STSHJob with the specified job number and state.
  */
-  STSHJob(size_t num, STSHJobState state) : num(num), state(state) {}
+  STSHJob(size_t num, STSHJobState state) : num(num), state(state), timed(false), processIndex(NULL) {}
 
 /**
  * Method: STSHJob
@@ -76,8 +88,10 @@ public:
  * Method: addProcess
  * ------------------
  * Appends the provided STSHProcess to be sequence of previously appended processes.
+ * If the job is owned by an STSHJobList, the process is indexed by pid as well, so
+ * the job list can find it in constant time.
  */
-  void addProcess(const STSHProcess& process) { processes.push_back(process); }
+  void addProcess(const STSHProcess& process);
 
 /**
  * Method: getProcesses
@@ -127,9 +141,56 @@ public:
  */
   pid_t getGroupID() const { return processes.empty() ? 0 : processes[0].getID(); }
 
+/**
+ * Method: isFinished
+ * ------------------
+ * Returns true if and only if every process in the job has terminated.
+ */
+  bool isFinished() const;
+
+/**
+ * Methods: setTimed, isTimed
+ * --------------------------
+ * Marks the job as one whose resource usage should be reported once it
+ * finishes (as the time builtin asks for), and reports whether it's been marked.
+ */
+  void setTimed(bool timed) { this->timed = timed; }
+  bool isTimed() const { return timed; }
+
+/**
+ * Method: getUsage
+ * ----------------
+ * Returns the resource usage of the entire job: the CPU times and context
+ * switches of all of its processes added up, and the largest of their
+ * maximum resident set sizes.
+ */
+  struct rusage getUsage() const;
+
+/**
+ * Method: getWallTime
+ * -------------------
+ * Returns the number of seconds between the launch of the job's first
+ * process and the termination of its last (or now, if some are still running).
+ */
+  double getWallTime() const;
+
+/**
+ * Method: printUsage
+ * ------------------
+ * Prints a table of the resource usage of each of the job's processes,
+ * followed by the job's total, so the most expensive stage of a pipeline
+ * stands out.  Usage is as of each process's most recent change of state,
+ * so a process that has been running all along shows only its wall time.
+ */
+  void printUsage(std::ostream& os) const;
+
 private:
   size_t num;
   std::vector<STSHProcess> processes;
   STSHJobState state;
+  bool timed;
+  STSHProcessIndex *processIndex; // the owning job list's index, or NULL if not in a job list
   static STSHProcess nprocess;
+
+  friend class STSHJobList;
 };
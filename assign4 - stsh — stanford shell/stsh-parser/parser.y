@@ -8,11 +8,30 @@
 
 %defines "parser.h"
 
+%code requires {
+#include <cstddef>
+
+/**
+ * A command's arguments are collected in a list whose nodes live in the
+ * pipeline's arena, and once they're all known, they're copied into an argv
+ * array of exactly the right size.
+ */
+struct wordNode {
+  char *word;
+  wordNode *next;
+};
+
+struct wordList {
+  wordNode *first;
+  wordNode *last;
+  size_t count;
+};
+}
+
 %{
 #include <vector>
 #include "stsh-parse.h"
    
-#include <cstring>     // for strncpy
 #include <iostream>    // for cout, endl
    
 extern int yylex();
@@ -26,7 +45,7 @@ void yyerror(pipeline& finalPipeLine, const char *s) { std::cerr << "ERROR: " <<
   struct command cmd;
   char *word;
   std::vector<command> *cmd_list;
-  std::vector<char *> *arg_list;
+  struct wordList arg_list;
   int token;
   bool background;
 }
@@ -86,27 +105,34 @@ in_out_cmd:  in_redir out_redir cmd { finalPipeLine.commands.push_back($3); }
           |  cmd                    { finalPipeLine.commands.push_back($1); }
 ;
 
-in_redir:    LT WORD                { finalPipeLine.input = std::string($2); free($2);}
+in_redir:    LT WORD                { finalPipeLine.input = std::string($2); }
 ;
 
-out_redir:   GT WORD                { finalPipeLine.output = std::string($2); free($2);}
+out_redir:   GT WORD                { finalPipeLine.output = std::string($2); }
 ;
 
-cmd:    WORD arg_list               { strncpy($$.command, $1, kMaxCommandLength);
-                                      free($1);
-                                      $$.command[kMaxCommandLength] = '\0';
-                                      size_t i;
-                                      for (i = 0; i < std::min((size_t)$2->size(), kMaxArguments); i++) {
-                                        $$.tokens[i] = $2->at(i);
+cmd:    WORD arg_list               { $$.argv = static_cast<char **>(finalPipeLine.arena.allocate(($2.count + 2) * sizeof(char *)));
+                                      $$.argv[0] = $1;
+                                      size_t i = 1;
+                                      for (wordNode *node = $2.first; node != NULL; node = node->next) {
+                                        $$.argv[i++] = node->word;
                                       }
-                                      $$.tokens[i] = NULL; // null terminate the arg list
-                                      delete $2;
+                                      $$.argv[i] = NULL; // null terminate the arg list
+                                      $$.command = $$.argv[0];
+                                      $$.tokens = $$.argv + 1;
                                     }
 ;
 
 
-arg_list:   /* can be empty */      { $$ = new std::vector<char *>(); }
-          | arg_list WORD           { $$ = $1; $$->push_back($2); }
+arg_list:   /* can be empty */      { $$.first = $$.last = NULL; $$.count = 0; }
+          | arg_list WORD           { wordNode *node = static_cast<wordNode *>(finalPipeLine.arena.allocate(sizeof(wordNode)));
+                                      node->word = $2;
+                                      node->next = NULL;
+                                      $$ = $1;
+                                      if ($$.last == NULL) $$.first = node; else $$.last->next = node;
+                                      $$.last = node;
+                                      $$.count++;
+                                    }
 ;
 
 %%
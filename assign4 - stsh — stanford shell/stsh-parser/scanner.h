@@ -8,8 +8,18 @@
 #ifndef _scanner_h_
 #define _scanner_h_
 
+#include <cstddef>
+
 extern char *yytext;
 int yylex();
 bool initScanner();
 
+/**
+ * Function: saveWord
+ * ------------------
+ * Copies a word the scanner matched into the arena of the pipeline
+ * being parsed, so it's freed along with the pipeline.
+ */
+char *saveWord(const char *text, size_t length);
+
 #endif
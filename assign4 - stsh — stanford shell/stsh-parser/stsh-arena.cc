@@ -0,0 +1,40 @@
+/**
+ * File: stsh-arena.cc
+ * -------------------
+ * Presents the implementation of the STSHArena class.
+ */
+
+#include "stsh-arena.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+using namespace std;
+
+STSHArena::~STSHArena() {
+  for (char *block: blocks) free(block);
+}
+
+void *STSHArena::allocate(size_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  if (size > remaining) {
+    while (blockSize < size) blockSize *= 2;
+    blockSize *= 2;
+    char *block = static_cast<char *>(malloc(blockSize));
+    if (block == NULL) throw bad_alloc();
+    blocks.push_back(block);
+    next = block;
+    remaining = blockSize;
+  }
+
+  void *memory = next;
+  next += size;
+  remaining -= size;
+  return memory;
+}
+
+char *STSHArena::copy(const char *str, size_t length) {
+  char *copy = static_cast<char *>(allocate(length + 1));
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
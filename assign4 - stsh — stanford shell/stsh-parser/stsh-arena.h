@@ -0,0 +1,66 @@
+/**
+ * File: stsh-arena.h
+ * ------------------
+ * Exports the STSHArena class, which hands out memory for the
+ * words and argument vectors of a single parsed command line.
+ * Nothing allocated from an arena is freed individually; all of it
+ * goes away at once when the arena itself is destroyed.
+ *
+ * A typical command line fits within the arena's first block, which
+ * lives inside the arena itself, so parsing it never calls malloc.
+ */
+
+#ifndef _stsh_arena_
+#define _stsh_arena_
+
+#include <cstddef>
+#include <vector>
+
+class STSHArena {
+ public:
+
+/**
+ * Constructor: STSHArena
+ * ----------------------
+ * Constructs an empty arena.
+ */
+  STSHArena() : next(initial), remaining(sizeof(initial)), blockSize(sizeof(initial)) {}
+
+/**
+ * Destructor: ~STSHArena
+ * ----------------------
+ * Frees everything ever allocated from the arena.
+ */
+  ~STSHArena();
+
+/**
+ * Method: allocate
+ * ----------------
+ * Returns size bytes of memory, aligned well enough for pointers,
+ * that remain valid for as long as the arena does.
+ */
+  void *allocate(size_t size);
+
+/**
+ * Method: copy
+ * ------------
+ * Returns a null-terminated copy of the first length characters
+ * of str, allocated from the arena.
+ */
+  char *copy(const char *str, size_t length);
+
+ private:
+  static const size_t kInitialSize = 1024;
+  static const size_t kAlignment = sizeof(void *);
+
+  alignas(void *) char initial[kInitialSize];
+  char *next;                // where the next allocation comes from
+  size_t remaining;          // bytes left in the current block
+  size_t blockSize;          // size of the current block; each new one is twice as large
+  std::vector<char *> blocks; // every block malloced after the first
+
+  STSHArena(const STSHArena& original) = delete;
+  STSHArena& operator=(const STSHArena& rhs) = delete;
+};
+
+#endif
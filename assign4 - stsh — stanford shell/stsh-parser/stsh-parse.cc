@@ -20,29 +20,26 @@ extern int yyparse(pipeline &finalPipeline);
 extern YY_BUFFER_STATE yy_scan_string(const char * str);
 extern void yy_delete_buffer(YY_BUFFER_STATE buffer);
 
+static STSHArena *arena; // the arena of the pipeline being parsed
+
+char *saveWord(const char *text, size_t length) {
+  return arena->copy(text, length);
+}
+
 pipeline::pipeline(const string& str) {
+  ::arena = &arena;
   YY_BUFFER_STATE state = yy_scan_string(str.c_str());
   int result = yyparse(*this);
   yy_delete_buffer(state);
   if (result != 0) throw STSHParseException();
 }
 
-pipeline::~pipeline() {
-  input.clear();
-  output.clear();
-  for (const command& cmd: commands) {
-    for (size_t i = 0; i <= kMaxArguments && cmd.tokens[i] != NULL; i++) {
-      free(cmd.tokens[i]);
-    }
-  }
-}
-
 ostream& operator<<(ostream& os, const pipeline& p) {
   if (!p.input.empty()) os << "Input File: " << p.input << endl;
   if (!p.output.empty()) os << "Output File: " << p.output << endl;
   for (size_t i = 0; i < p.commands.size(); i++) {
     os << "Executable " << i << ": " << p.commands[i].command << endl;
-    for (size_t j = 0; j <= kMaxArguments && p.commands[i].tokens[j] != NULL; j++) {
+    for (size_t j = 0; p.commands[i].tokens[j] != NULL; j++) {
       os << "       Arg " << j << ": " << p.commands[i].tokens[j] << endl;
     }
   }
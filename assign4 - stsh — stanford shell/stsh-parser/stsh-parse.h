@@ -13,13 +13,18 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include "stsh-arena.h"
 
-const size_t kMaxCommandLength = 32;
-const size_t kMaxArguments = 32;
-
+/**
+ * A command's words all live in the arena of the pipeline holding it,
+ * and there's no limit on how long they are or how many there are.
+ * argv is laid out exactly as execvp wants it, and command and tokens
+ * just point into it.
+ */
 struct command {
-  char command[kMaxCommandLength + 1]; // NULL terminated
-  char *tokens[kMaxArguments + 1]; // array, C strings are all NULL terminated
+  char **argv;    // the command followed by its arguments, NULL terminated
+  char *command;  // argv[0]
+  char **tokens;  // argv + 1, so just the arguments, NULL terminated
 };
 
 struct pipeline {
@@ -27,6 +32,7 @@ struct pipeline {
   std::string output;  // empty if no output redirection file from last command
   std::vector<command> commands;
   bool background;
+  STSHArena arena;     // holds every command's words and argv
 
 /**
  * Accepts a command line and parses it to construct the pipeline.
@@ -70,9 +76,14 @@ struct pipeline {
   pipeline(const std::string& str);
 
 /**
- * It frees the dynamically allocated char *s containing the argument lists.
+ * Everything the commands point to lives in the arena, so it's all
+ * freed at once.
  */
-  ~pipeline();
+  ~pipeline() {}
+
+ private:
+  pipeline(const pipeline& original) = delete;
+  pipeline& operator=(const pipeline& rhs) = delete;
 };
 
 std::ostream& operator<<(std::ostream& os, const pipeline& p);
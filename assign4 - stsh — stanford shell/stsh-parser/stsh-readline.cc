@@ -2,7 +2,7 @@
  * File: stsh-readline.cc
  * ----------------------
  * Presents the implementation of the readline function, which can be configured to use 
- * the GNU readline library.
+ * the GNU readline library, or to read lines from a script or a -c command instead.
  */
 
 #include "stsh-readline.h"
@@ -15,15 +15,22 @@
 #include <cctype>
 #include <locale>
 #include <getopt.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include "string-utils.h"
 using namespace std;
 
 static string prompt = "stsh> ";
 static bool history = true;
+static int input = STDIN_FILENO; // where lines are read from, or -1 if there's nothing more to read
+static string buffered;          // input read in but not yet returned as a line
 static const int kIncorrectUsage = 1;
+static const int kUnreadableScript = 127;
 static void printUsage(const string& message, const string& executable) {
   cerr << "Error: " << message << endl;
-  cerr << "Usage: ./" << executable << " [--suppress-prompt] [--no-history]" << endl;
+  cerr << "Usage: ./" << executable << " [--suppress-prompt] [--no-history] [-c command | script]" << endl;
   exit(kIncorrectUsage);
 }
 
@@ -31,11 +38,13 @@ void rlinit(int argc, char *argv[]) {
   struct option options[] = {
     {"suppress-prompt", no_argument, NULL, 's'},
     {"no-history", no_argument, NULL, 'n'},
+    {"command", required_argument, NULL, 'c'},
     {NULL, 0, NULL, 0},
   };
 
+  bool command = false;
   while (true) {
-    int ch = getopt_long(argc, argv, "sn", options, NULL);
+    int ch = getopt_long(argc, argv, "snc:", options, NULL);
     if (ch == -1) break;
     switch (ch) {
     case 's':
@@ -44,28 +53,130 @@ void rlinit(int argc, char *argv[]) {
     case 'n':
       history = false;
       break;
+    case 'c':
+      command = true;
+      buffered = string(optarg) + "\n";
+      input = -1;
+      break;
     default:
       printUsage("Unrecognized flag.", argv[0]);
     }
   }
 
   argc -= optind;
-  if (argc > 0) printUsage("Too many arguments.", argv[0]);
+  if (argc > (command ? 0 : 1)) printUsage("Too many arguments.", argv[0]);
+  if (argc == 1) {
+    input = open(argv[optind], O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+      cerr << "Error: Could not open " << argv[optind] << "." << endl;
+      exit(kUnreadableScript);
+    }
+  }
+
+  if (command || argc == 1) { // scripts and commands are read without prompts or history
+    prompt = "";
+    history = false;
+  }
+}
+
+/**
+ * Function: waitForInput
+ * ----------------------
+ * Blocks until the input is readable, calling onReady every
+ * time fd becomes readable in the meantime.  A negative fd is never
+ * watched.
+ */
+static void waitForInput(int fd, void (*onReady)()) {
+  struct pollfd fds[] = {{input, POLLIN, 0}, {fd, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return; // let the read that follows surface the problem
+    }
+    if (fds[1].revents != 0) onReady();
+    if (fds[0].revents != 0) return;
+  }
+}
+
+/**
+ * Function: checkReady
+ * --------------------
+ * Calls onReady if fd is readable right now, without waiting on it.
+ */
+static void checkReady(int fd, void (*onReady)()) {
+  if (fd < 0 || onReady == NULL) return;
+  struct pollfd ready = {fd, POLLIN, 0};
+  if (poll(&ready, 1, 0) > 0) onReady();
+}
+
+/**
+ * Function: readBufferedLine
+ * --------------------------
+ * Places the next line of input (standard input, or else the script or
+ * -c command) into line, reading it in large chunks rather than a character
+ * at a time.  A final line without a newline is still returned.  Returns false
+ * once all input is consumed.  Whenever a line is returned straight from the
+ * buffer, fd is checked anyway, so events are handled between every pair of
+ * lines rather than only when more input has to be read.
+ */
+static bool readBufferedLine(string& line, int fd, void (*onReady)()) {
+  size_t newline;
+  while ((newline = buffered.find('\n')) == string::npos) {
+    char chunk[4096];
+    ssize_t count = 0;
+    if (input >= 0) {
+      waitForInput(fd, onReady);
+      count = read(input, chunk, sizeof(chunk));
+    }
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) {
+      line = buffered;
+      buffered.clear();
+      checkReady(fd, onReady);
+      return !line.empty();
+    }
+    buffered.append(chunk, count);
+  }
+
+  checkReady(fd, onReady);
+  line = buffered.substr(0, newline);
+  buffered.erase(0, newline + 1);
+  return true;
+}
+
+static string *pending; // where the line handler places the line being read
+static bool lineRead, endOfInput;
+
+static void lineHandler(char *s) {
+  rl_callback_handler_remove();
+  lineRead = true;
+  endOfInput = s == NULL;
+  if (s == NULL) return;
+  *pending = s;
+  free(s);
 }
 
 bool readline(string& line) {
+  return readline(line, -1, NULL);
+}
+
+bool readline(string& line, int fd, void (*onReady)()) {
   line.clear();
   if (!history) {
-    cout << prompt;
-    getline(cin, line);
+    cout << prompt << flush;
+    bool more = readBufferedLine(line, fd, onReady);
     trim(line);
-    return !cin.eof();
+    return more;
   }
   
-  char *s = readline(prompt.c_str());
-  if (s == NULL) return false;
-  line = s;
-  free(s);
+  pending = &line;
+  lineRead = false;
+  rl_callback_handler_install(prompt.c_str(), lineHandler);
+  while (!lineRead) {
+    waitForInput(fd, onReady);
+    rl_callback_read_char();
+  }
+  if (endOfInput) return false;
   trim(line);
   if (!line.empty()) 
     add_history(line.c_str());
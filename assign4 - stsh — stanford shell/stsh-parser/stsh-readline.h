@@ -3,7 +3,9 @@
  * ---------------------
  * Exports a simple wrapper around the built-in getline function that
  * uses the specified prompt and (optionally) relies on the GNU readline
- * library for tab completion and history support.
+ * library for tab completion and history support.  Lines can also come
+ * from a script or a -c command, in which case there's no prompt, no
+ * history, and no readline library at all.
  */
 
 #ifndef _stsh_readline_
@@ -15,7 +17,10 @@
  * Function: rlinit
  * ----------------
  * Configures the stsh-readline module using information provided
- * via the main function's argument count and vector.
+ * via the main function's argument count and vector.  Besides the
+ * --suppress-prompt and --no-history flags, it accepts either
+ * -c command, whose lines are then all readline returns, or the name
+ * of a script file to read lines from instead of standard input.
  */
 void rlinit(int argc, char *argv[]);
 
@@ -29,4 +34,15 @@ void rlinit(int argc, char *argv[]);
  */
 bool readline(std::string& line);
 
+/**
+ * Function: readline
+ * ------------------
+ * Behaves just like the version above, except that while it waits on
+ * input, it also watches fd and calls onReady every time fd becomes
+ * readable.  That lets the caller respond to other events (e.g. signals
+ * arriving on a signalfd) synchronously, without losing the partially
+ * entered line.
+ */
+bool readline(std::string& line, int fd, void (*onReady)());
+
 #endif
@@ -6,14 +6,38 @@
 
 #include "stsh-process.h"
 #include <iomanip>  // for setw, left
+#include <ctime>    // for clock_gettime
 using namespace std;
 
-STSHProcess::STSHProcess(pid_t pid, const command& command, STSHProcessState state) : pid(pid), state(state) {
+double monotonicTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+STSHProcess::STSHProcess(pid_t pid, const command& command, STSHProcessState state) :
+  pid(pid), state(state), usage(), startTime(monotonicTime()), endTime(0) {
   tokens.push_back(command.command);
   for (char * const *tokenp = &command.tokens[0]; *tokenp != NULL; tokenp++)
     tokens.push_back(*tokenp);
 }
 
+void STSHProcess::setState(STSHProcessState state) {
+  if (state == kTerminated && this->state != kTerminated) endTime = monotonicTime();
+  this->state = state;
+}
+
+double STSHProcess::getWallTime() const {
+  if (startTime == 0) return 0;
+  return (endTime != 0 ? endTime : monotonicTime()) - startTime;
+}
+
+string STSHProcess::getCommandLine() const {
+  string line;
+  for (const string& token: tokens) line += (line.empty() ? "" : " ") + token;
+  return line;
+}
+
 static ostream& operator<<(ostream& os, STSHProcessState state) {
   const char *str = "Unknown";
   switch (state) {
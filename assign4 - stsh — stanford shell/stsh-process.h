@@ -17,6 +17,7 @@
 #include <vector>   // for vector
 #include <string>   // for string
 #include <iostream> // for ostream
+#include <sys/resource.h> // for struct rusage
 
 /**
  * Enumerated Type: STSHProcessState
@@ -48,13 +49,14 @@ public:
  * ------------------------
  * Default constructor, where the process id is set to 0 as a placeholder.
  */
-  STSHProcess(): pid(0) {}
+  STSHProcess(): pid(0), usage(), startTime(0), endTime(0) {}
 
 /**
  * Constructor: STSHProcess
  * ------------------------
  * Constructs the object to package the provided pid, command line, and process state
- * together.
+ * together.  The process is assumed to have been launched just now, and its wall
+ * time is measured from here.
  */
   STSHProcess(pid_t pid, const command& command, STSHProcessState state = kRunning);
 
@@ -76,12 +78,61 @@ public:
 /**
  * Method: setState
  * ----------------
- * Sets the state of the process to be that provided.
+ * Sets the state of the process to be that provided.  When that state is
+ * kTerminated, the process's wall time stops accumulating.
  */
-  void setState(STSHProcessState state) { this->state = state; }
+  void setState(STSHProcessState state);
+
+/**
+ * Method: setUsage
+ * ----------------
+ * Records the resource usage wait4 reported along with the process's
+ * most recent change of state.
+ */
+  void setUsage(const struct rusage& usage) { this->usage = usage; }
+
+/**
+ * Method: getUsage
+ * ----------------
+ * Returns the resource usage recorded by the last call to setUsage, which
+ * is all zeroes if the process hasn't changed state since it was launched.
+ */
+  const struct rusage& getUsage() const { return usage; }
+
+/**
+ * Method: getWallTime
+ * -------------------
+ * Returns the number of seconds between the process's launch and its
+ * termination, or between its launch and now if it hasn't terminated.
+ */
+  double getWallTime() const;
+
+/**
+ * Method: getStartTime
+ * --------------------
+ * Returns the time the process was launched, in seconds on the monotonic clock.
+ */
+  double getStartTime() const { return startTime; }
+
+/**
+ * Method: getCommandLine
+ * ----------------------
+ * Returns the process's command and arguments, separated by spaces.
+ */
+  std::string getCommandLine() const;
 
 private:
   pid_t pid;
   std::vector<std::string> tokens;
   STSHProcessState state;
+  struct rusage usage;
+  double startTime;
+  double endTime; // 0 until the process terminates
 };
+
+/**
+ * Function: monotonicTime
+ * -----------------------
+ * Returns the current time, in seconds on the monotonic clock.
+ */
+double monotonicTime();
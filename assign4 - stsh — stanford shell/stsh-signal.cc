@@ -8,6 +8,8 @@
  */
 
 #include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
 #include "stsh-signal.h"
 #include "stsh-exception.h"
 using namespace std;
@@ -19,4 +21,18 @@ void installSignalHandler(int signum, handler_t handler) {
   action.sa_flags = SA_RESTART; // restart system calls if possible  
   if (sigaction(signum, &action, NULL) < 0) 
     throw STSHException("Failed to install a handler for signal with number " + to_string(signum) + ".");
-}
\ No newline at end of file
+}
+
+int installSignalDescriptor(const sigset_t& signals) {
+  if (sigprocmask(SIG_BLOCK, &signals, NULL) < 0)
+    throw STSHException("Failed to block the signals to be read from a signalfd.");
+  int fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd < 0) throw STSHException("Failed to create a signalfd.");
+  return fd;
+}
+
+int readSignal(int fd) {
+  struct signalfd_siginfo info;
+  if (read(fd, &info, sizeof(info)) != sizeof(info)) return 0;
+  return info.ssi_signo;
+}
@@ -6,9 +6,14 @@
  * on page 752.
  *
  * This is a slightly more robust version of the signal system call.
+ *
+ * Also defines installSignalDescriptor and readSignal, which let
+ * signals be handled synchronously, by whatever loop reads them
+ * from a signalfd, rather than asynchronously by a handler.
  */
 
 #pragma once
+#include <signal.h>
 
 /**
  * Type: handler_t
@@ -29,3 +34,21 @@ typedef void (*handler_t)(int);
  */
 void installSignalHandler(int signum, handler_t handler);
 
+/**
+ * Function: installSignalDescriptor
+ * ---------------------------------
+ * Blocks the specified signals and returns a signalfd that becomes
+ * readable whenever any of them is pending.  The descriptor is
+ * nonblocking and close-on-exec, but the signal mask is inherited
+ * by children, so they should unblock the signals before calling execvp.
+ */
+int installSignalDescriptor(const sigset_t& signals);
+
+/**
+ * Function: readSignal
+ * --------------------
+ * Consumes the next pending signal from a descriptor created by
+ * installSignalDescriptor and returns its number, or returns 0
+ * if no signal is pending.
+ */
+int readSignal(int fd);
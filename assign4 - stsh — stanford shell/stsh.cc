@@ -5,34 +5,48 @@
 #include "stsh-job-list.h"
 #include "stsh-job.h"
 #include "stsh-process.h"
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
 #include <algorithm>
 #include <fcntl.h>
-#include <unistd.h>  // for fork
+#include <spawn.h>   // for posix_spawnp
+#include <unistd.h>
 #include <signal.h>  // for kill
+#include <poll.h>    // for poll
 #include <sys/wait.h>
+#include <sys/resource.h> // for wait4
 using namespace std;
 
 // Built in functions
 static void forgroundBuiltIn(char* input);
 static void backgroundBuiltIn(char* input);
 static void processBuiltIn(char* arg1, char* arg2, int sig);
+static void jobsBuiltIn(char* arg);
+static bool stripTimePrefix(pipeline& p);
 
-// Signal Handlers
+// Signal Handlers (SIGCHLD, SIGINT, and SIGTSTP are read from a signalfd and dispatched by handleSignals)
 static void childStatusHandler(int sig);
 static void stopHandler(int sig);
 static void intHandler(int sig);
+static void handleSignals();
 
 // Control flow
 static void runJob(size_t jobNum, STSHJobState state);
 static size_t addToJobList(const vector<STSHProcess>& processes, STSHJobState state);
-static void createJob(const pipeline& p);
-static void createProcesses(vector<STSHProcess>& jobProcesses, const pipeline& p);
+static void createJob(const pipeline& p, bool timed);
+static bool createProcesses(vector<STSHProcess>& jobProcesses, const pipeline& p);
 static void stsh_wait(STSHJob& job);
 
 static STSHJobList joblist; // the one piece of global data we need so signal handlers can access it
+static sigset_t jobControlSignals; // SIGCHLD, SIGINT, and SIGTSTP, which stay blocked in stsh itself
+static int signalDescriptor;       // the signalfd they're read from
+static int exitStatus = 0;         // status of the last foreground job or builtin, which stsh exits with
+
+static const int kBuiltinFailure = 1;
+static const int kCommandNotFound = 127;
+static const int kSignalStatusBase = 128; // a job killed or stopped by a signal has status 128 + the signal number
 
 bool isNumber(char *s)
 {
@@ -51,7 +65,7 @@ static void foregroundBuiltIn(char* input)
   if (joblist.containsJob(jobNum))
   {
     if (joblist.hasForegroundJob())
-      raise(SIGTSTP);
+      stopHandler(SIGTSTP);
     kill(-joblist.getJob(jobNum).getGroupID(), SIGCONT);
     runJob(jobNum, kForeground);
   }
@@ -91,53 +105,105 @@ static void processBuiltIn(char *arg1, char *arg2, int sig)
     throw STSHException("No such process");
 }
 
+static void jobsBuiltIn(char *arg)
+{
+  if (arg == NULL)
+    cout << joblist;
+  else if (strcmp(arg, "-l") == 0)
+    joblist.printUsage(cout);
+  else
+    throw STSHException("Usage: jobs [-l].");
+}
+
+/**
+ * Function: stripTimePrefix
+ * -------------------------
+ * If the pipeline starts with the time builtin, removes it (so the rest
+ * of the pipeline runs as usual) and returns true.  The resource usage
+ * of the job is then reported once it finishes.
+ */
+static bool stripTimePrefix(pipeline& p)
+{
+  if (p.commands.empty() || strcmp(p.commands[0].command, "time") != 0) return false;
+  command& cmd = p.commands[0];
+  if (cmd.tokens[0] == NULL) throw STSHException("Usage: time <pipeline>.");
+  cmd.argv++;
+  cmd.command = cmd.argv[0];
+  cmd.tokens = cmd.argv + 1;
+  return true;
+}
+
 /**
  *  * Function: handleBuiltin
  *  * * -----------------------
  *  * Examines the leading command of the provided pipeline to see if
  *  * it's a shell builtin, and if so, handles and executes it.  handleBuiltin
  *  * returns true if the command is a builtin, and false otherwise.
+ *  * Builtins can't be timed, so a timed builtin is rejected before it runs.
  *   */
 static const string kSupportedBuiltins[] = {"quit", "exit", "fg", "bg", "slay", "halt", "cont", "jobs"};
 static const size_t kNumSupportedBuiltins = sizeof(kSupportedBuiltins)/sizeof(kSupportedBuiltins[0]);
-static bool handleBuiltin(const pipeline& pipeline) {
+static bool handleBuiltin(const pipeline& pipeline, bool timed) {
   const string& command = pipeline.commands[0].command;
   auto iter = find(kSupportedBuiltins, kSupportedBuiltins + kNumSupportedBuiltins, command);
   if (iter == kSupportedBuiltins + kNumSupportedBuiltins) return false;
+  if (timed) throw STSHException("time: can't time a builtin");
   size_t index = iter - kSupportedBuiltins;
 
+  int lastStatus = exitStatus;
+  exitStatus = 0; // a failing builtin throws, and fg takes on the status of the job it waits on
   switch (index) {
     case 0:
-    case 1: exit(0);
+    case 1: exit(pipeline.commands[0].tokens[0] ? atoi(pipeline.commands[0].tokens[0]) : lastStatus);
     case 2: foregroundBuiltIn(pipeline.commands[0].tokens[0]); break;
     case 3: backgroundBuiltIn(pipeline.commands[0].tokens[0]); break;
     case 4: processBuiltIn(pipeline.commands[0].tokens[0], pipeline.commands[0].tokens[1], SIGKILL); break;
     case 5: processBuiltIn(pipeline.commands[0].tokens[0], pipeline.commands[0].tokens[1], SIGTSTP); break;
     case 6: processBuiltIn(pipeline.commands[0].tokens[0], pipeline.commands[0].tokens[1], SIGCONT); break;
-    case 7: cout << joblist; break;
+    case 7: jobsBuiltIn(pipeline.commands[0].tokens[0]); break;
     default: throw STSHException("Internal Error: Builtin command not supported."); // or not implemented yet
   }
 
   return true;
 }
 
+/**
+ * Records the status of a foreground pipeline's last process as stsh's
+ * exit status, much as sh does.
+ */
+static void recordStatus(int status)
+{
+  if (WIFEXITED(status))
+    exitStatus = WEXITSTATUS(status);
+  else if (WIFSIGNALED(status))
+    exitStatus = kSignalStatusBase + WTERMSIG(status);
+  else if (WIFSTOPPED(status))
+    exitStatus = kSignalStatusBase + WSTOPSIG(status);
+}
+
 static void childStatusHandler(int sig)
 {
   while(true)
   {
     int status;
-    pid_t pid = waitpid(-1, &status, WUNTRACED|WCONTINUED|WNOHANG);
+    struct rusage usage;
+    pid_t pid = wait4(-1, &status, WUNTRACED|WCONTINUED|WNOHANG, &usage);
     if (pid <= 0) break;
     if (joblist.containsProcess(pid))
     {
       STSHJob& job = joblist.getJobWithProcess(pid);
       STSHProcess& process = job.getProcess(pid);
+      process.setUsage(usage);
       if (WIFEXITED(status) || WIFSIGNALED(status))
         process.setState(kTerminated);
       if (WIFSTOPPED(status))
         process.setState(kStopped); 
       if (WIFCONTINUED(status))
         process.setState(kRunning);
+      if (job.getState() == kForeground && &process == &job.getProcesses().back())
+        recordStatus(status);
+      if (job.isTimed() && job.isFinished())
+        job.printUsage(cerr); // the job list is about to forget it
       joblist.synchronize(job);
     }
   }
@@ -160,100 +226,140 @@ static void intHandler(int sig)
     kill(-joblist.getForegroundJob().getGroupID(), SIGKILL);
 }
 
+/**
+ * Function: handleSignals
+ * -----------------------
+ * Dispatches every job control signal pending on the signalfd to its
+ * handler.  This is only ever called from the main loop (directly, or
+ * from readline while it waits on input), so the handlers run synchronously
+ * and can touch the job list without blocking anything.
+ */
+static void handleSignals()
+{
+  int sig;
+  while ((sig = readSignal(signalDescriptor)) != 0)
+  {
+    switch (sig)
+    {
+      case SIGCHLD: childStatusHandler(sig); break;
+      case SIGINT: intHandler(sig); break;
+      case SIGTSTP: stopHandler(sig); break;
+    }
+  }
+}
+
 /**
  *  * Function: installSignalHandlers
  *  * -------------------------------
- *  * Installs user-defined signals handlers for four signals
- *  * (once you've implemented signal handlers for SIGCHLD, 
- *  * SIGINT, and SIGTSTP, you'll add more installSignalHandler calls) and 
- *  * ignores two others.
+ *  * Installs user-defined signals handlers for two signals and 
+ *  * ignores two others.  SIGCHLD, SIGINT, and SIGTSTP are blocked
+ *  * instead, and read from a signalfd by the main loop.
  *  */
 static void installSignalHandlers() {
   installSignalHandler(SIGQUIT, [](int sig) { exit(0); });
   installSignalHandler(SIGTTIN, SIG_IGN);
   installSignalHandler(SIGTTOU, SIG_IGN);
-  signal(SIGCHLD, childStatusHandler);
-  signal(SIGINT, intHandler);
-  signal(SIGTSTP, stopHandler);
   signal(SIGCONT, contHandler);
+  sigemptyset(&jobControlSignals);
+  sigaddset(&jobControlSignals, SIGCHLD);
+  sigaddset(&jobControlSignals, SIGINT);
+  sigaddset(&jobControlSignals, SIGTSTP);
+  signalDescriptor = installSignalDescriptor(jobControlSignals);
 }
 
-static void readPipe(int read[2])
-{
-  if (close(read[1]) < 0)
-    perror("close");
-  if (dup2(read[0], STDIN_FILENO) < 0)
-    perror("dup2");
-}
-
-static void writePipe(int write[2])
+/**
+ * Opens the named redirection file for the job, close-on-exec so only
+ * the process it's dup2'ed into keeps it.  As with a failed dup2, a file
+ * that can't be opened is reported and the process just keeps the
+ * shell's descriptor.
+ */
+static int openRedirect(const string& file, int redirect)
 {
-  if (close(write[0]) < 0)
-    perror("close");
-  if (dup2(write[1], STDOUT_FILENO) < 0)
-    perror("dup2");
+  if (file.empty()) return -1;
+  int flags = O_CLOEXEC;
+  if (redirect == STDIN_FILENO) flags |= O_RDONLY;
+  if (redirect == STDOUT_FILENO) flags |= O_CREAT|O_WRONLY|O_TRUNC;
+  int fd = open(file.c_str(), flags, 0644);
+  if (fd < 0) perror("open");
+  return fd;
 }
 
-static void redirect(const char* file, int redirect)
+static void closeDescriptor(int fd)
 {
-  int flags = 0;
-  if (redirect == STDIN_FILENO) flags = O_RDONLY;
-  if (redirect == STDOUT_FILENO) flags = O_CREAT|O_WRONLY|O_TRUNC;
-  int fd = open(file, flags, 0644);
-  if (fd < 0) perror("open");
-
-  if (dup2(fd, redirect) < 0) perror("dup2");
-
-  if (close(fd) < 0) perror("close");
+  if (fd >= 0 && close(fd) < 0) perror("close");
 }
 
 /**
  * Create a list of processes from a parsed command
+ *
+ * Each process is launched with posix_spawnp rather than fork and execvp, so
+ * the shell's address space is never copied.  The file actions wire up the
+ * pipes and redirections, POSIX_SPAWN_SETPGROUP puts every process in the
+ * first one's process group, and POSIX_SPAWN_SETSIGMASK unblocks the job
+ * control signals stsh reads from its signalfd.  Every pipe and redirection
+ * descriptor is close-on-exec, so each process holds just its own ends.
+ * A command that can't be run is reported here, and the rest of the
+ * pipeline carries on without it.  Returns false if that happened to the
+ * last command, whose status would otherwise be the pipeline's.
 */
-static void createProcesses(vector<STSHProcess>& jobProcesses, const pipeline& p)
+static bool createProcesses(vector<STSHProcess>& jobProcesses, const pipeline& p)
 {
   size_t nCommands = p.commands.size();
   size_t nPipes = nCommands-1;
   int fds[nPipes][2];
   pid_t pgid = 0;
   pid_t pid;
-  const char* outfile = NULL;
-  const char* infile = NULL;
+  int infile = openRedirect(p.input, STDIN_FILENO);
+  int outfile = openRedirect(p.output, STDOUT_FILENO);
+  bool launchedLast = false;
 
-  if (p.output != "") outfile = p.output.c_str();
-  if (p.input != "") infile = p.input.c_str();
+  sigset_t mask;
+  sigprocmask(SIG_BLOCK, NULL, &mask);
+  for (int sig = 1; sig < NSIG; sig++)
+    if (sigismember(&jobControlSignals, sig)) sigdelset(&mask, sig);
 
   for (size_t i = 0; i < nCommands; i++)
   {
-    char *argv[kMaxArguments + 2];
-    argv[0] = (char *) p.commands[i].command;
-    
-    size_t j = 0;
-    while((argv[j+1] = p.commands[i].tokens[j])) j++;
-    argv[j+1] = NULL;
-
-    if (i < nPipes) pipe(fds[i]);
-    if ( (pid = fork()) == 0)
+    char **argv = p.commands[i].argv;
+    if (i < nPipes && pipe2(fds[i], O_CLOEXEC) < 0) perror("pipe");
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (i > 0) posix_spawn_file_actions_adddup2(&actions, fds[i-1][0], STDIN_FILENO);
+    if (i < nPipes) posix_spawn_file_actions_adddup2(&actions, fds[i][1], STDOUT_FILENO);
+    if (i == 0 && infile >= 0) posix_spawn_file_actions_adddup2(&actions, infile, STDIN_FILENO);
+    if (i == nCommands-1 && outfile >= 0) posix_spawn_file_actions_adddup2(&actions, outfile, STDOUT_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setsigmask(&attr, &mask);
+
+    int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    // the new process has its ends of the pipes now
+    if (i > 0) closeDescriptor(fds[i-1][0]);
+    if (i < nPipes) closeDescriptor(fds[i][1]);
+
+    if (err != 0)
     {
-      setpgid(0, pgid);
-      if (i > 0) readPipe(fds[i-1]);
-      if (i < nPipes) writePipe(fds[i]);
-
-      if (i == 0 && infile) redirect(infile, STDIN_FILENO);
-      if (i == nCommands-1 && outfile) redirect(outfile, STDOUT_FILENO);
-
-      execvp(argv[0], argv);
-      throw STSHException(strcat(argv[0],": command not found"));
+      cerr << argv[0] << ": command not found" << endl;
+      launchedLast = false;
+      continue;
     }
 
-    if (i > 0 && close(fds[i-1][1]) < 0) perror("close");
-
-    if (i == 0) pgid = pid;
-    setpgid(pid, pgid);
-
+    if (pgid == 0) pgid = pid;
     STSHProcess process = STSHProcess(pid, p.commands[i], kWaiting);
     jobProcesses.push_back(process);
+    launchedLast = true;
   }
+
+  closeDescriptor(infile);
+  closeDescriptor(outfile);
+  return launchedLast;
 }
 
 /**
@@ -267,19 +373,17 @@ static size_t addToJobList(vector<STSHProcess>& processes, STSHJobState state)
   return job.getNum();
 }
 
+// Handle signals until the job leaves the foreground (the job list erases it once it's terminated)
 static void stsh_wait(STSHJob& job)
 {
-    sigset_t mask, oldMask;
-    sigemptyset(&oldMask);
-    sigaddset(&oldMask, SIGCHLD);
-    sigprocmask(SIG_BLOCK, &oldMask, &mask);
-
+    size_t jobNum = job.getNum();
     bool termCtr = (tcsetpgrp(STDIN_FILENO, job.getGroupID()) == 0) ? true : false;
-    while(job.getState() == kForeground)  
+    struct pollfd signals = {signalDescriptor, POLLIN, 0};
+    while(joblist.containsJob(jobNum) && joblist.getJob(jobNum).getState() == kForeground)  
     {
-      sigsuspend(&mask);
+      poll(&signals, 1, -1);
+      handleSignals();
     }
-    sigprocmask(SIG_UNBLOCK, &oldMask, NULL);
     if (termCtr) tcsetpgrp(STDIN_FILENO, getpid());
 }
 
@@ -296,15 +400,20 @@ static void runJob(size_t jobNum, STSHJobState state)
 /**
  *  * Function: createJob
  *  * -------------------
- *  * Creates a new job on behalf of the provided pipeline.
+ *  * Creates a new job on behalf of the provided pipeline.  If timed
+ *  * is true, the job's resource usage is reported once it finishes.
  *  */
-static void createJob(const pipeline& p)
+static void createJob(const pipeline& p, bool timed)
 {
   vector<STSHProcess> jobProcesses;
-  createProcesses(jobProcesses, p);
+  bool launchedLast = createProcesses(jobProcesses, p);
+  exitStatus = launchedLast ? 0 : kCommandNotFound; // sh gives background jobs a status of 0 as well
+  if (jobProcesses.empty()) return; // nothing could be run
   STSHJobState state = p.background ? kBackground : kForeground;
   size_t newJobNum = addToJobList(jobProcesses, state);
+  joblist.getJob(newJobNum).setTimed(timed);
   runJob(newJobNum, state);
+  if (!launchedLast) exitStatus = kCommandNotFound;
 }
 
 /**
@@ -312,25 +421,27 @@ static void createJob(const pipeline& p)
  *  * --------------
  *  * Defines the entry point for a process running stsh.
  *  * The main function is little more than a read-eval-print
- *  * loop (i.e. a repl).  
+ *  * loop (i.e. a repl).  Given -c command or a script, stsh
+ *  * runs its lines instead, and as with sh, exits with the
+ *  * status of the last foreground job or builtin.
  *  */
 int main(int argc, char *argv[]) {
-  pid_t stshpid = getpid();
   installSignalHandlers();
   rlinit(argc, argv);
   while (true) {
     string line;
-    if (!readline(line)) break;
+    if (!readline(line, signalDescriptor, handleSignals)) break;
     if (line.empty()) continue;
     try {
       pipeline p(line);
-      bool builtin = handleBuiltin(p);
-      if (!builtin) createJob(p);
+      bool timed = stripTimePrefix(p);
+      bool builtin = handleBuiltin(p, timed);
+      if (!builtin) createJob(p, timed);
     } catch (const STSHException& e) {
       cerr << e.what() << endl;
-      if (getpid() != stshpid) exit(0); // if exception is thrown from child process, kill it
+      exitStatus = kBuiltinFailure;
     }
   }
 
-  return 0;
+  return exitStatus;
 }
\ No newline at end of file